@@ -0,0 +1,130 @@
+// Gap/reserved-area cost benchmark.
+// Compares the per-window scalar arithmetic applyNodeGeometry used to do (list nodes, branch per
+// edge) with filling SNstackBoxes and running nstackApplyGaps over the whole workspace.
+// Usage: nstackGapsBench
+
+#include "../nstackGeometry.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <list>
+
+struct SBenchNode {
+    SNstackVec position, size;
+    SNstackVec reservedTopLeft, reservedBottomRight;
+    SNstackVec windowPosition, windowSize;
+};
+
+static bool sticks(double a, double b) {
+    return std::abs(a - b) < 2;
+}
+
+// what applyNodeGeometry does per window
+static void applyScalar(SBenchNode& n, const SNstackGapOptions& opts) {
+    const bool DISPLAYLEFT   = sticks(n.position.x, opts.areaTopLeft.x);
+    const bool DISPLAYRIGHT  = sticks(n.position.x + n.size.x, opts.areaBottomRight.x);
+    const bool DISPLAYTOP    = sticks(n.position.y, opts.areaTopLeft.y);
+    const bool DISPLAYBOTTOM = sticks(n.position.y + n.size.y, opts.areaBottomRight.y);
+
+    const auto OFFSETTOPLEFT     = SNstackVec(DISPLAYLEFT ? opts.gapsOut.left : opts.gapsIn.left, DISPLAYTOP ? opts.gapsOut.top : opts.gapsIn.top);
+    const auto OFFSETBOTTOMRIGHT = SNstackVec(DISPLAYRIGHT ? opts.gapsOut.right : opts.gapsIn.right, DISPLAYBOTTOM ? opts.gapsOut.bottom : opts.gapsIn.bottom);
+
+    auto       calcPos  = n.position + OFFSETTOPLEFT;
+    auto       calcSize = n.size - OFFSETTOPLEFT - OFFSETBOTTOMRIGHT;
+    calcPos             = calcPos + n.reservedTopLeft;
+    calcSize            = calcSize - (n.reservedTopLeft + n.reservedBottomRight);
+
+    if (opts.scale != 1.0) {
+        n.windowPosition = calcPos + SNstackVec((calcSize.x - calcSize.x * opts.scale) / 2.0, (calcSize.y - calcSize.y * opts.scale) / 2.0);
+        n.windowSize     = SNstackVec(calcSize.x * opts.scale, calcSize.y * opts.scale);
+    } else {
+        n.windowPosition = calcPos;
+        n.windowSize     = calcSize;
+    }
+}
+
+int main() {
+    SNstackGapOptions opts;
+    opts.gapsIn          = {5, 5, 5, 5};
+    opts.gapsOut         = {20, 20, 20, 20};
+    opts.areaTopLeft     = SNstackVec(0, 30);
+    opts.areaBottomRight = SNstackVec(2560, 1440);
+    opts.scale           = 0.8;
+
+    double checksum = 0;
+    int    mismatches = 0;
+
+    std::printf("%6s %12s %12s %12s\n", "nodes", "scalar ns", "soa ns", "kernel ns");
+
+    for (const int NODES : {16, 256, 4096}) {
+        std::list<SBenchNode> nodes;
+        SNstackGeometry       geom;
+        geom.monitorSize     = SNstackVec(2560, 1440);
+        geom.reservedTopLeft = SNstackVec(0, 30);
+        geom.nodes.resize(NODES);
+        geom.nodes[0].isMaster = true;
+        nstackComputeGeometry(geom);
+
+        for (size_t i = 0; i < geom.nodes.size(); ++i) {
+            auto& n    = nodes.emplace_back();
+            n.position = geom.nodes[i].position;
+            n.size     = geom.nodes[i].size;
+            if (i % 3 == 0)
+                n.reservedTopLeft = SNstackVec(0, 24); // a groupbar
+        }
+
+        SNstackBoxes boxes;
+        const auto   fill = [&] {
+            boxes.resize(nodes.size());
+            size_t i = 0;
+            for (const auto& n : nodes) {
+                boxes.x[i]              = n.position.x;
+                boxes.y[i]              = n.position.y;
+                boxes.w[i]              = n.size.x;
+                boxes.h[i]              = n.size.y;
+                boxes.reservedLeft[i]   = n.reservedTopLeft.x;
+                boxes.reservedTop[i]    = n.reservedTopLeft.y;
+                boxes.reservedRight[i]  = n.reservedBottomRight.x;
+                boxes.reservedBottom[i] = n.reservedBottomRight.y;
+                i++;
+            }
+        };
+
+        const int  ITERATIONS = 4000000 / NODES;
+
+        const auto BEGIN = std::chrono::steady_clock::now();
+        for (int it = 0; it < ITERATIONS; ++it) {
+            for (auto& n : nodes)
+                applyScalar(n, opts);
+            checksum += nodes.back().windowPosition.x;
+        }
+        const auto SCALAREND = std::chrono::steady_clock::now();
+        for (int it = 0; it < ITERATIONS; ++it) {
+            fill();
+            nstackApplyGaps(boxes, opts);
+            checksum += boxes.x[NODES - 1];
+        }
+        const auto SOAEND = std::chrono::steady_clock::now();
+        for (int it = 0; it < ITERATIONS; ++it) {
+            nstackApplyGaps(boxes, opts);
+            checksum += boxes.x[NODES - 1];
+        }
+        const auto KERNELEND = std::chrono::steady_clock::now();
+
+        // both paths have to agree
+        fill();
+        nstackApplyGaps(boxes, opts);
+        size_t i = 0;
+        for (const auto& n : nodes) {
+            if (n.windowPosition.x != boxes.x[i] || n.windowPosition.y != boxes.y[i] || n.windowSize.x != boxes.w[i] || n.windowSize.y != boxes.h[i])
+                mismatches++;
+            i++;
+        }
+
+        const auto PERNODE = [&](auto from, auto to) { return std::chrono::duration<double, std::nano>(to - from).count() / ((double)ITERATIONS * NODES); };
+        std::printf("%6d %12.2f %12.2f %12.2f\n", NODES, PERNODE(BEGIN, SCALAREND), PERNODE(SCALAREND, SOAEND), PERNODE(SOAEND, KERNELEND));
+    }
+
+    std::printf("mismatches %d, checksum %.0f\n", mismatches, checksum);
+    return mismatches != 0;
+}
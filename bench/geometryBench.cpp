@@ -0,0 +1,165 @@
+// Layout cost benchmark for the pure geometry engine.
+// Sweeps node counts across every orientation x order combination and reports ns/node,
+// computed from scratch and served from the shape cache. Layouts the cache can't serve (see
+// isCacheable) are marked, their cached column is the fallback to computing them.
+// Then checks the cache against nstackComputeGeometry over random monitors, reserved areas,
+// options and previous stacks, and reports every box, stack or master ratio that differs.
+// Usage: nstackBench [max nodes] [differential cases]
+
+#include "../nstackGeometry.hpp"
+#include "../nstackShapeCache.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+static const char* ORIENTATIONS[] = {"left", "top", "right", "bottom", "hcenter", "vcenter"};
+static const char* ORDERS[]       = {"row", "column", "rrow", "rcolumn"};
+
+static SNstackGeometry makeGeometry(int nodes, eColOrientation orientation, eColOrder order) {
+    SNstackGeometry geom;
+    geom.monitorPosition     = SNstackVec(0, 0);
+    geom.monitorSize         = SNstackVec(2560, 1440);
+    geom.reservedTopLeft     = SNstackVec(0, 30);
+    geom.reservedBottomRight = SNstackVec(0, 0);
+    geom.options.stackCount  = 3;
+    geom.options.orientation = orientation;
+    geom.options.order       = order;
+
+    geom.nodes.resize(nodes);
+    geom.nodes[0].isMaster = true;
+    return geom;
+}
+
+static bool sameBox(const SNstackGeometryNode& a, const SNstackGeometryNode& b) {
+    // the geometry works in float and the cache scales normalized boxes back up, so a few
+    // thousandths of a pixel apart is the same box
+    const auto CLOSE = [](double x, double y) { return std::abs(x - y) < 0.01; };
+    return CLOSE(a.position.x, b.position.x) && CLOSE(a.position.y, b.position.y) && CLOSE(a.size.x, b.size.x) && CLOSE(a.size.y, b.size.y);
+}
+
+// nodes that came out differently from the cache than from nstackComputeGeometry
+static int compareWithCache(CNstackShapeCache& cache, const SNstackGeometry& input) {
+    auto       direct = input;
+    auto       cached = input;
+    const bool DIRECT = nstackComputeGeometry(direct);
+    const bool CACHED = cache.compute(cached);
+
+    if (DIRECT != CACHED)
+        return 1;
+    if (!DIRECT)
+        return 0;
+
+    int mismatches = direct.stackNodeCount != cached.stackNodeCount;
+    for (size_t i = 0; i < direct.nodes.size(); ++i) {
+        const auto& D = direct.nodes[i];
+        const auto& C = cached.nodes[i];
+        if (!sameBox(D, C) || D.stackNum != C.stackNum || D.percMaster != C.percMaster)
+            mismatches++;
+    }
+    return mismatches;
+}
+
+// every shape is laid out on a few monitors in a row, so cached layouts get replayed at other sizes
+static int differentialCheck(int cases) {
+    std::mt19937      rng(1);
+    const auto        PICK     = [&](int min, int max) { return std::uniform_int_distribution<int>(min, max)(rng); };
+    const auto        CHANCE   = [&](int percent) { return PICK(1, 100) <= percent; };
+    const int         BARS[]   = {0, 0, 0, 24, 30, 48};
+    const float       MFACTS[] = {0.0f, 0.5f, 0.6f};
+    const float       XFACTS[] = {0.0f, 0.0f, 0.2f};
+
+    CNstackShapeCache cache;
+    int               mismatches = 0, runs = 0;
+
+    for (int c = 0; c < cases; ++c) {
+        SNstackGeometry geom;
+        auto&           opts      = geom.options;
+        opts.stackCount           = PICK(2, 5);
+        opts.center_single_master = CHANCE(30);
+        opts.master_factor        = MFACTS[PICK(0, 2)];
+        opts.single_master_factor = CHANCE(50) ? 0.5f : 0.7f;
+        opts.x_factor             = XFACTS[PICK(0, 2)];
+        opts.orientation          = (eColOrientation)PICK(0, NSTACK_ORIENTATION_VCENTER);
+        opts.order                = (eColOrder)PICK(0, NSTACK_ORDER_RCOLUMN);
+
+        geom.nodes.resize(PICK(1, 16));
+        for (auto& n : geom.nodes) {
+            n.isMaster = CHANCE(15);
+            n.stackNum = PICK(0, opts.stackCount - 1);
+            n.percSize = CHANCE(5) ? 1.3f : 1.f;
+        }
+        geom.nodes[PICK(0, geom.nodes.size() - 1)].isMaster = true;
+
+        for (int run = 0; run < 3; ++run) {
+            geom.monitorPosition     = SNstackVec(PICK(0, 2) * 1920, 0);
+            geom.monitorSize         = SNstackVec(PICK(640, 5120), PICK(480, 2880));
+            geom.reservedTopLeft     = SNstackVec(BARS[PICK(0, 5)], BARS[PICK(0, 5)]);
+            geom.reservedBottomRight = SNstackVec(BARS[PICK(0, 5)], BARS[PICK(0, 5)]);
+
+            mismatches += compareWithCache(cache, geom);
+            runs++;
+
+            // usually the next pass starts from the stacks this one ended in, like the layout does
+            if (CHANCE(70)) {
+                auto laidOut = geom;
+                if (nstackComputeGeometry(laidOut)) {
+                    for (size_t i = 0; i < geom.nodes.size(); ++i)
+                        geom.nodes[i].stackNum = laidOut.nodes[i].stackNum;
+                }
+            }
+        }
+    }
+
+    const auto STATS = cache.stats();
+    std::printf("differential: %d layouts, %lu cached, %lu uncacheable, mismatches %d\n", runs, (unsigned long)STATS.hits, (unsigned long)STATS.uncacheable, mismatches);
+    return mismatches;
+}
+
+int main(int argc, char** argv) {
+    const int MAXNODES = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const int CASES    = argc > 2 ? std::atoi(argv[2]) : 100000;
+    double    checksum = 0;
+
+    std::printf("%-8s %-8s %6s %10s %10s\n", "orient", "order", "nodes", "ns/node", "cached");
+
+    for (int o = 0; o <= NSTACK_ORIENTATION_VCENTER; ++o) {
+        for (int r = 0; r <= NSTACK_ORDER_RCOLUMN; ++r) {
+            for (int nodes = 1; nodes <= MAXNODES; nodes *= 10) {
+                auto      geom = makeGeometry(nodes, (eColOrientation)o, (eColOrder)r);
+
+                // keep the amount of work per measurement roughly constant
+                const int ITERATIONS = nodes < 2000000 / 20 ? 2000000 / nodes : 20;
+
+                nstackComputeGeometry(geom);
+
+                const auto BEGIN = std::chrono::steady_clock::now();
+                for (int i = 0; i < ITERATIONS; ++i) {
+                    nstackComputeGeometry(geom);
+                    checksum += geom.nodes.back().position.x;
+                }
+                const auto        END = std::chrono::steady_clock::now();
+
+                CNstackShapeCache cache;
+                cache.compute(geom);
+
+                const auto CACHEDBEGIN = std::chrono::steady_clock::now();
+                for (int i = 0; i < ITERATIONS; ++i) {
+                    cache.compute(geom);
+                    checksum += geom.nodes.back().position.x;
+                }
+                const auto   CACHEDEND = std::chrono::steady_clock::now();
+
+                const double NS       = std::chrono::duration<double, std::nano>(END - BEGIN).count();
+                const double CACHEDNS = std::chrono::duration<double, std::nano>(CACHEDEND - CACHEDBEGIN).count();
+                std::printf("%-8s %-8s %6d %10.2f %10.2f%s\n", ORIENTATIONS[o], ORDERS[r], nodes, NS / ((double)ITERATIONS * nodes), CACHEDNS / ((double)ITERATIONS * nodes),
+                            cache.stats().uncacheable ? " (uncacheable)" : "");
+            }
+        }
+    }
+
+    std::printf("checksum %.0f\n", checksum);
+
+    return differentialCheck(CASES) != 0;
+}
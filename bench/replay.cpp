@@ -0,0 +1,519 @@
+// Replays a layout recording (layoutmsg record <path>) against a headless model of the layout.
+// The model mirrors what the plugin does with its nodes on every recorded event and lays out the
+// shown workspaces through the same geometry engine and shape cache, without a compositor, gaps
+// or window updates. Reports time per event type, the slowest events and a hash of the final
+// geometry, so a recording can gate regressions: same hash, no slower.
+// Usage: nstackReplay <recording> [runs]
+
+#include "../nstackCommands.hpp"
+#include "../nstackGeometry.hpp"
+#include "../nstackRecord.hpp"
+#include "../nstackShapeCache.hpp"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+struct SReplayWorkspace {
+    SNstackRecordWorkspace data;
+    SNstackGeometry        geom;    // persistent nodes in layout order
+    std::vector<uint32_t>  windows; // window of every node in geom.nodes
+    uint32_t               fullscreen = 0;
+};
+
+struct SReplayEventStats {
+    uint64_t count   = 0;
+    uint64_t totalNs = 0;
+    uint64_t maxNs   = 0;
+};
+
+struct SReplaySlowEvent {
+    uint64_t           ns    = 0;
+    size_t             index = 0;
+    eNstackRecordEvent type  = NSTACK_RECORD_MONITOR;
+};
+
+static std::vector<std::string> split(const std::string& str, char delim) {
+    std::vector<std::string> out;
+    std::stringstream        stream(str);
+    std::string              part;
+    while (std::getline(stream, part, delim)) {
+        part.erase(0, part.find_first_not_of(' '));
+        part.erase(part.find_last_not_of(' ') + 1);
+        if (!part.empty())
+            out.push_back(part);
+    }
+    return out;
+}
+
+class CReplayModel {
+  public:
+    void apply(const SNstackRecordEvent& event) {
+        switch (event.type) {
+            case NSTACK_RECORD_MONITOR:
+                m_mMonitors[event.monitor.id] = event.monitor;
+                layout(event.monitor.activeSpecialWorkspace);
+                layout(event.monitor.activeWorkspace);
+                break;
+            case NSTACK_RECORD_WORKSPACE:
+                m_mWorkspaces[event.workspaceData.id].data = event.workspaceData;
+                if (shown(event.workspaceData.id))
+                    layout(event.workspaceData.id);
+                break;
+            case NSTACK_RECORD_ADOPT: {
+                auto& ws = workspace(event.workspace);
+                ws.geom.nodes.push_back(event.node);
+                ws.windows.push_back(event.window);
+                m_mWindows[event.window] = event.workspace;
+                break;
+            }
+            case NSTACK_RECORD_WINDOW_CREATED: createWindow(event); break;
+            case NSTACK_RECORD_WINDOW_REMOVED: removeWindow(event.window); break;
+            case NSTACK_RECORD_RESIZE: resizeWindow(event.window, event.delta); break;
+            case NSTACK_RECORD_LAYOUTMSG: layoutMessage(event.window, event.message); break;
+            case NSTACK_RECORD_SWITCH_WINDOWS: switchWindows(event.window, event.window2); break;
+            case NSTACK_RECORD_FULLSCREEN: {
+                const auto IT = m_mWindows.find(event.window);
+                if (IT == m_mWindows.end())
+                    break;
+                auto& ws      = workspace(IT->second);
+                ws.fullscreen = event.arg2 ? event.window : 0;
+                if (!ws.fullscreen)
+                    layout(IT->second);
+                break;
+            }
+            case NSTACK_RECORD_COUNT: break;
+        }
+    }
+
+    // what the idle precompute would leave behind: every workspace on a monitor laid out
+    void settle() {
+        for (const auto& [id, ws] : m_mWorkspaces)
+            layout(id);
+    }
+
+    uint64_t hash() const {
+        uint64_t   hash = 14695981039346656037ull;
+        const auto mix  = [&hash](const void* data, size_t size) {
+            for (size_t i = 0; i < size; ++i) {
+                hash ^= ((const uint8_t*)data)[i];
+                hash *= 1099511628211ull;
+            }
+        };
+
+        for (const auto& [id, ws] : m_mWorkspaces) {
+            mix(&id, sizeof(id));
+            for (size_t i = 0; i < ws.geom.nodes.size(); ++i) {
+                const auto& N = ws.geom.nodes[i];
+                mix(&ws.windows[i], sizeof(uint32_t));
+                mix(&N.position, sizeof(N.position));
+                mix(&N.size, sizeof(N.size));
+            }
+        }
+        return hash;
+    }
+
+    size_t windows() const {
+        return m_mWindows.size();
+    }
+
+    uint64_t passes() const {
+        return m_iPasses;
+    }
+
+  private:
+    std::map<int64_t, SReplayWorkspace>     m_mWorkspaces;
+    std::map<int64_t, SNstackRecordMonitor> m_mMonitors;
+    std::unordered_map<uint32_t, int64_t>   m_mWindows;
+    CNstackShapeCache                       m_cShapeCache;
+    uint64_t                                m_iPasses = 0;
+
+    SReplayWorkspace& workspace(int64_t id) {
+        auto& ws   = m_mWorkspaces[id];
+        ws.data.id = id;
+        return ws;
+    }
+
+    bool shown(int64_t id) {
+        for (const auto& [mid, m] : m_mMonitors) {
+            if (m.activeWorkspace == id || m.activeSpecialWorkspace == id)
+                return true;
+        }
+        return false;
+    }
+
+    void layout(int64_t id) {
+        const auto WSIT = m_mWorkspaces.find(id);
+        if (WSIT == m_mWorkspaces.end())
+            return;
+
+        auto&      ws  = WSIT->second;
+        const auto MIT = m_mMonitors.find(ws.data.monitor);
+        if (MIT == m_mMonitors.end() || ws.geom.nodes.empty() || ws.fullscreen)
+            return;
+
+        ws.geom.monitorPosition     = MIT->second.position;
+        ws.geom.monitorSize         = MIT->second.size;
+        ws.geom.reservedTopLeft     = MIT->second.reservedTopLeft;
+        ws.geom.reservedBottomRight = MIT->second.reservedBottomRight;
+        ws.geom.options             = ws.data.options;
+        m_cShapeCache.compute(ws.geom);
+        m_iPasses++;
+    }
+
+    int find(const SReplayWorkspace& ws, uint32_t window) {
+        const auto IT = std::find(ws.windows.begin(), ws.windows.end(), window);
+        return IT == ws.windows.end() ? -1 : IT - ws.windows.begin();
+    }
+
+    int masters(const SReplayWorkspace& ws) {
+        return std::count_if(ws.geom.nodes.begin(), ws.geom.nodes.end(), [](const auto& n) { return n.isMaster; });
+    }
+
+    // onWindowCreatedTiling
+    void createWindow(const SNstackRecordEvent& event) {
+        auto&      ws    = workspace(event.workspace);
+        const bool FRONT = ws.data.newOnTop;
+        const auto IDX   = FRONT ? 0 : ws.geom.nodes.size();
+
+        ws.geom.nodes.insert(ws.geom.nodes.begin() + IDX, SNstackGeometryNode{});
+        ws.windows.insert(ws.windows.begin() + IDX, event.window);
+        m_mWindows[event.window] = event.workspace;
+
+        const int  WINDOWS  = ws.geom.nodes.size();
+        const bool PROMOTED = ws.data.autoPromote > 1 && WINDOWS == ws.data.autoPromote;
+        const bool MASTER   = ws.data.newIsMaster || WINDOWS == 1 || (!(event.arg2 & NSTACK_RECORD_CREATE_FIRST_MAP) && (event.arg2 & NSTACK_RECORD_CREATE_OPENING_ON_MASTER));
+
+        auto& node = ws.geom.nodes[IDX];
+        if (MASTER || PROMOTED) {
+            for (size_t i = 0; i < ws.geom.nodes.size(); ++i) {
+                auto& n = ws.geom.nodes[i];
+                if (i != IDX && n.isMaster) {
+                    n.isMaster          = PROMOTED;
+                    node.percMaster     = n.percMaster;
+                    node.masterAdjusted = n.masterAdjusted;
+                    break;
+                }
+            }
+            node.isMaster = true;
+        }
+
+        layout(event.workspace);
+    }
+
+    // onWindowRemovedTiling
+    void removeWindow(uint32_t window) {
+        const auto IT = m_mWindows.find(window);
+        if (IT == m_mWindows.end())
+            return;
+
+        const auto WSID = IT->second;
+        auto&      ws   = workspace(WSID);
+        const int  IDX  = find(ws, window);
+        m_mWindows.erase(IT);
+        if (IDX < 0)
+            return;
+
+        const auto NODE        = ws.geom.nodes[IDX];
+        const int  MASTERSLEFT = masters(ws);
+
+        if (NODE.isMaster && MASTERSLEFT < 2) {
+            for (auto& n : ws.geom.nodes) {
+                if (!n.isMaster) {
+                    n.isMaster       = true;
+                    n.percMaster     = NODE.percMaster;
+                    n.masterAdjusted = NODE.masterAdjusted;
+                    break;
+                }
+            }
+        }
+
+        ws.geom.nodes.erase(ws.geom.nodes.begin() + IDX);
+        ws.windows.erase(ws.windows.begin() + IDX);
+
+        const int WINDOWS = ws.geom.nodes.size();
+        if (!NODE.isMaster && (masters(ws) == WINDOWS || WINDOWS < ws.data.autoDemote) && MASTERSLEFT > 1 && WINDOWS)
+            ws.geom.nodes.back().isMaster = false;
+
+        if (ws.fullscreen == window)
+            ws.fullscreen = 0;
+
+        layout(WSID);
+    }
+
+    // resizeActiveWindow
+    void resizeWindow(uint32_t window, const SNstackVec& delta) {
+        const auto IT = m_mWindows.find(window);
+        if (IT == m_mWindows.end())
+            return;
+
+        auto&      ws  = workspace(IT->second);
+        const auto MIT = m_mMonitors.find(ws.data.monitor);
+        const int  IDX = find(ws, window);
+        if (MIT == m_mMonitors.end() || IDX < 0)
+            return;
+
+        const auto& MONITOR = MIT->second;
+        auto&       geom    = ws.geom;
+        auto&       node    = geom.nodes[IDX];
+        const auto  ORIENT  = ws.data.options.orientation;
+        const int   MASTERS = masters(ws);
+        const int   WINDOWS = geom.nodes.size();
+        bool        xDone   = false, yDone = false;
+
+        if (node.isMaster) {
+            double masterDelta = 0;
+            switch (ORIENT) {
+                case NSTACK_ORIENTATION_LEFT:
+                case NSTACK_ORIENTATION_HCENTER: masterDelta = delta.x / MONITOR.size.x; break;
+                case NSTACK_ORIENTATION_RIGHT: masterDelta = -delta.x / MONITOR.size.x; break;
+                case NSTACK_ORIENTATION_TOP:
+                case NSTACK_ORIENTATION_VCENTER: masterDelta = delta.y / MONITOR.size.y; break;
+                case NSTACK_ORIENTATION_BOTTOM: masterDelta = -delta.y / MONITOR.size.y; break;
+            }
+            xDone = ORIENT == NSTACK_ORIENTATION_LEFT || ORIENT == NSTACK_ORIENTATION_RIGHT || ORIENT == NSTACK_ORIENTATION_HCENTER;
+            yDone = !xDone;
+
+            for (auto& n : geom.nodes) {
+                if (n.isMaster) {
+                    n.percMaster     = std::clamp(n.percMaster + masterDelta, 0.05, 0.95);
+                    n.masterAdjusted = true;
+                }
+            }
+        }
+
+        const SNstackGeometryNode* PMASTER = nullptr;
+        for (const auto& n : geom.nodes) {
+            if (n.isMaster) {
+                PMASTER = &n;
+                break;
+            }
+        }
+
+        // percSize inside a row/column, stackPercs across them
+        const auto resizeAxis = [&](double pix, double monitorSize, double reserved, double masterSize, bool inStack) {
+            if (node.isMaster && MASTERS > 1 && inStack)
+                node.percSize = std::clamp(node.percSize + pix / ((monitorSize - reserved) / MASTERS), 0.05, 1.95);
+            else if (!node.isMaster && WINDOWS - MASTERS > 1 && node.stackNum < (int)geom.stackNodeCount.size()) {
+                if (inStack)
+                    node.percSize = std::clamp(node.percSize + pix / ((monitorSize - reserved) / geom.stackNodeCount[node.stackNum]), 0.05, 1.95);
+                else if (node.stackNum < (int)geom.stackPercs.size()) {
+                    auto& perc = geom.stackPercs[node.stackNum];
+                    perc       = std::clamp(perc + pix / ((monitorSize - reserved - masterSize) / geom.stackNodeCount.size()), 0.05, 1.95);
+                }
+            }
+        };
+
+        if (delta.x != 0 && !xDone)
+            resizeAxis(delta.x, MONITOR.size.x, MONITOR.reservedTopLeft.x + MONITOR.reservedBottomRight.x, PMASTER ? PMASTER->size.x : 0, ORIENT % 2 == 1);
+        if (delta.y != 0 && !yDone)
+            resizeAxis(delta.y, MONITOR.size.y, MONITOR.reservedTopLeft.y + MONITOR.reservedBottomRight.y, PMASTER ? PMASTER->size.y : 0, ORIENT % 2 == 0);
+
+        layout(IT->second);
+    }
+
+    // swaps which windows two nodes hold, the geometry stays
+    void switchWindows(uint32_t window, uint32_t window2) {
+        const auto IT  = m_mWindows.find(window);
+        const auto IT2 = m_mWindows.find(window2);
+        if (IT == m_mWindows.end() || IT2 == m_mWindows.end())
+            return;
+
+        auto&     ws   = workspace(IT->second);
+        auto&     ws2  = workspace(IT2->second);
+        const int IDX  = find(ws, window);
+        const int IDX2 = find(ws2, window2);
+        if (IDX < 0 || IDX2 < 0)
+            return;
+
+        std::swap(ws.windows[IDX], ws2.windows[IDX2]);
+        std::swap(IT->second, IT2->second);
+    }
+
+    void layoutMessage(uint32_t window, const std::string& message) {
+        const auto IT = m_mWindows.find(window);
+        if (IT == m_mWindows.end())
+            return;
+
+        const auto WSID = IT->second;
+        auto       args = split(message, ' ');
+        if (args.empty())
+            return;
+
+        if (args[0] == "batch") {
+            const auto REST = message.substr(message.find("batch") + 5);
+            for (const auto& c : split(REST, ';'))
+                runCommand(WSID, window, split(c, ' '));
+        } else
+            runCommand(WSID, window, args);
+
+        layout(WSID);
+    }
+
+    // the part of runLayoutMessage that changes the layout, focus and tracing are left out
+    void runCommand(int64_t wsid, uint32_t window, const std::vector<std::string>& args) {
+        if (args.empty())
+            return;
+
+        auto&      ws      = workspace(wsid);
+        auto&      options = ws.data.options;
+        const int  IDX     = find(ws, window);
+        const auto COMMAND = nstackLookupCommand(args[0]);
+
+        if (IDX < 0)
+            return;
+
+        switch (COMMAND) {
+            // swapwithmaster, swapnext/prev and swapdir go through switchWindows, which records its own event
+            case NSTACK_CMD_ADDMASTER: {
+                if (!ws.geom.nodes[IDX].isMaster) {
+                    ws.geom.nodes[IDX].isMaster = true;
+                    break;
+                }
+                for (auto& n : ws.geom.nodes) {
+                    if (!n.isMaster) {
+                        n.isMaster = true;
+                        break;
+                    }
+                }
+                break;
+            }
+            case NSTACK_CMD_REMOVEMASTER: {
+                if (ws.geom.nodes.size() < 2 || masters(ws) < 2)
+                    break;
+                if (ws.geom.nodes[IDX].isMaster) {
+                    ws.geom.nodes[IDX].isMaster = false;
+                    break;
+                }
+                for (auto it = ws.geom.nodes.rbegin(); it != ws.geom.nodes.rend(); ++it) {
+                    if (it->isMaster) {
+                        it->isMaster = false;
+                        break;
+                    }
+                }
+                break;
+            }
+            case NSTACK_CMD_TOGGLEMASTER:
+                if (!ws.geom.nodes[IDX].isMaster || masters(ws) > 1)
+                    ws.geom.nodes[IDX].isMaster = !ws.geom.nodes[IDX].isMaster;
+                break;
+            case NSTACK_CMD_ORIENTATIONLEFT: options.orientation = NSTACK_ORIENTATION_LEFT; break;
+            case NSTACK_CMD_ORIENTATIONRIGHT: options.orientation = NSTACK_ORIENTATION_RIGHT; break;
+            case NSTACK_CMD_ORIENTATIONTOP: options.orientation = NSTACK_ORIENTATION_TOP; break;
+            case NSTACK_CMD_ORIENTATIONBOTTOM: options.orientation = NSTACK_ORIENTATION_BOTTOM; break;
+            case NSTACK_CMD_ORIENTATIONHCENTER: options.orientation = NSTACK_ORIENTATION_HCENTER; break;
+            case NSTACK_CMD_ORIENTATIONVCENTER: options.orientation = NSTACK_ORIENTATION_VCENTER; break;
+            // orientationcycle with a custom list is settled by the workspace event recorded after it
+            case NSTACK_CMD_ORIENTATIONNEXT:
+            case NSTACK_CMD_ORIENTATIONPREV:
+                options.orientation = (eColOrientation)((options.orientation + (COMMAND == NSTACK_CMD_ORIENTATIONNEXT ? 1 : NSTACK_ORIENTATION_VCENTER)) %
+                                                        (NSTACK_ORIENTATION_VCENTER + 1));
+                break;
+            case NSTACK_CMD_RESETSPLITS:
+                ws.geom.stackPercs.clear();
+                ws.geom.stackNodeCount.clear();
+                break;
+            case NSTACK_CMD_SETSTACKCOUNT:
+                if (args.size() >= 2) {
+                    const int COUNT = args[1][0] == '+' || args[1][0] == '-' ? options.stackCount + std::atoi(args[1].c_str()) : std::atoi(args[1].c_str());
+                    if (COUNT)
+                        options.stackCount = std::max(COUNT, 2);
+                }
+                break;
+            case NSTACK_CMD_ORDERROW: options.order = NSTACK_ORDER_ROW; break;
+            case NSTACK_CMD_ORDERCOLUMN: options.order = NSTACK_ORDER_COLUMN; break;
+            case NSTACK_CMD_ORDERRROW: options.order = NSTACK_ORDER_RROW; break;
+            case NSTACK_CMD_ORDERRCOLUMN: options.order = NSTACK_ORDER_RCOLUMN; break;
+            case NSTACK_CMD_ORDERNEXT: options.order = (eColOrder)((options.order + 1) % 4); break;
+            case NSTACK_CMD_ORDERPREV: options.order = (eColOrder)((options.order + 3) % 4); break;
+            case NSTACK_CMD_MFACT:
+                if (args.size() >= 2)
+                    options.master_factor = std::atof(args[1].c_str());
+                break;
+            case NSTACK_CMD_TOGGLEMFACT:
+                if (args.size() >= 2) {
+                    const float MFACT     = std::atof(args[1].c_str());
+                    options.master_factor = options.master_factor == MFACT ? 0 : MFACT;
+                }
+                break;
+            default: break;
+        }
+    }
+};
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <recording> [runs]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<SNstackRecordEvent> events;
+    if (!nstackReadRecording(argv[1], events)) {
+        std::fprintf(stderr, "%s: not a layout recording\n", argv[1]);
+        return 1;
+    }
+
+    const int                                          RUNS = argc > 2 ? std::max(1, std::atoi(argv[2])) : 1;
+    std::array<SReplayEventStats, NSTACK_RECORD_COUNT> stats{};
+    std::vector<SReplaySlowEvent>                      slowest;
+    uint64_t                                           hash    = 0, bestNs = UINT64_MAX;
+    size_t                                             windows = 0;
+    uint64_t                                           passes  = 0;
+
+    for (int run = 0; run < RUNS; ++run) {
+        CReplayModel model;
+        uint64_t     runNs = 0;
+
+        for (size_t i = 0; i < events.size(); ++i) {
+            const auto BEGIN = std::chrono::steady_clock::now();
+            model.apply(events[i]);
+            const uint64_t NS = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - BEGIN).count();
+            runNs += NS;
+
+            auto& s = stats[events[i].type];
+            s.count++;
+            s.totalNs += NS;
+            s.maxNs = std::max(s.maxNs, NS);
+
+            if (run == 0)
+                slowest.push_back({NS, i, events[i].type});
+        }
+
+        model.settle();
+
+        if (run > 0 && model.hash() != hash) {
+            std::fprintf(stderr, "replay isn't deterministic: run %d hashed %016llx, run 0 %016llx\n", run, (unsigned long long)model.hash(), (unsigned long long)hash);
+            return 1;
+        }
+
+        hash    = model.hash();
+        windows = model.windows();
+        passes  = model.passes();
+        bestNs  = std::min(bestNs, runNs);
+    }
+
+    std::printf("%zu events, %d run(s), %zu windows left, %llu layout passes per run\n\n", events.size(), RUNS, windows, (unsigned long long)passes);
+    std::printf("%-14s %8s %12s %10s %10s\n", "event", "count", "total us", "mean ns", "max ns");
+    for (size_t t = 0; t < NSTACK_RECORD_COUNT; ++t) {
+        const auto& S = stats[t];
+        if (!S.count)
+            continue;
+        std::printf("%-14s %8llu %12.1f %10.0f %10llu\n", NSTACK_RECORD_NAMES[t], (unsigned long long)(S.count / RUNS), S.totalNs / 1000.0 / RUNS, (double)S.totalNs / S.count,
+                    (unsigned long long)S.maxNs);
+    }
+
+    std::sort(slowest.begin(), slowest.end(), [](const auto& a, const auto& b) { return a.ns > b.ns; });
+    slowest.resize(std::min<size_t>(slowest.size(), 5));
+
+    std::printf("\nslowest events (first run):\n");
+    for (const auto& s : slowest)
+        std::printf("  #%-8zu %-14s at %10.3f ms: %llu ns\n", s.index, NSTACK_RECORD_NAMES[s.type], events[s.index].timeNs / 1e6, (unsigned long long)s.ns);
+
+    std::printf("\nbest run: %.1f us\ngeometry hash: %016llx\n", bestNs / 1000.0, (unsigned long long)hash);
+    return 0;
+}
@@ -1,4 +1,5 @@
 #include "globals.hpp"
+#include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/config/ConfigManager.hpp>
 #include <hyprland/src/desktop/DesktopTypes.hpp>
 #include <hyprland/src/desktop/Workspace.hpp>
@@ -18,6 +19,42 @@ static void deleteWorkspaceData(int ws) {
         g_pNstackLayout->removeWorkspaceData(ws);
 }
 
+static void configReloadedCallback(void* self, SCallbackInfo& cinfo, std::any data) {
+    if (!g_pNstackLayout)
+        return;
+
+    // resolved workspace options are cached, drop them and lay out again with the new values
+    g_pNstackLayout->invalidateWorkspaceOptions();
+    for (auto& m : g_pCompositor->m_monitors)
+        g_pNstackLayout->scheduleRecalculateMonitor(m->m_id);
+}
+
+static void preRenderCallback(void* self, SCallbackInfo& cinfo, std::any data) {
+    if (!g_pNstackLayout)
+        return;
+
+    // flushes interactive resizes, once per monitor frame
+    g_pNstackLayout->onPreRender(std::any_cast<PHLMONITOR>(data));
+}
+
+// hyprctl nstack [stats|reset]
+static std::string nstackCtlCommand(eHyprCtlOutputFormat format, std::string request) {
+    if (!g_pNstackLayout)
+        return "nstack not loaded";
+
+    CVarList vars(request, 0, ' ');
+
+    if (vars.size() < 2 || vars[1] == "stats")
+        return g_pNstackLayout->statsReport(format == FORMAT_JSON);
+
+    if (vars[1] == "reset") {
+        g_pNstackLayout->resetStats();
+        return "ok";
+    }
+
+    return "unknown nstack command, use: stats, reset";
+}
+
 void moveWorkspaceCallback(void* self, SCallbackInfo& cinfo, std::any data) {
     std::vector<std::any> moveData = std::any_cast<std::vector<std::any>>(data);
     PHLWORKSPACE          ws       = std::any_cast<PHLWORKSPACE>(moveData.front());
@@ -27,23 +64,21 @@ void moveWorkspaceCallback(void* self, SCallbackInfo& cinfo, std::any data) {
 APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
     PHANDLE = handle;
 
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:orientation", Hyprlang::STRING{"left"});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:new_on_top", Hyprlang::INT{0});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:new_is_master", Hyprlang::INT{1});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:no_gaps_when_only", Hyprlang::INT{0});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:special_scale_factor", Hyprlang::FLOAT{0.8f});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:inherit_fullscreen", Hyprlang::INT{1});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:stacks", Hyprlang::INT{2});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:center_single_master", Hyprlang::INT{0});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:mfact", Hyprlang::FLOAT{0.5f});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:single_mfact", Hyprlang::FLOAT{0.5f});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:xfact", Hyprlang::FLOAT{0.0f});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:auto_promote", Hyprlang::INT{0});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:auto_demote", Hyprlang::INT{1});
-    HyprlandAPI::addConfigValue(PHANDLE, "plugin:nstack:layout:order", Hyprlang::STRING{"row"});
+    for (const auto& option : NSTACK_OPTIONS) {
+        const auto NAME = std::string{NSTACK_OPTION_CONFIG_PREFIX} + std::string{option.name};
+        switch (option.configType()) {
+            case NSTACK_OPTION_CONFIG_INT: HyprlandAPI::addConfigValue(PHANDLE, NAME, Hyprlang::INT{(Hyprlang::INT)option.defaultValue}); break;
+            case NSTACK_OPTION_CONFIG_FLOAT: HyprlandAPI::addConfigValue(PHANDLE, NAME, Hyprlang::FLOAT{option.defaultValue}); break;
+            case NSTACK_OPTION_CONFIG_STRING: HyprlandAPI::addConfigValue(PHANDLE, NAME, Hyprlang::STRING{option.defaultString.data()}); break;
+        }
+    }
 
     g_pNstackLayout  = std::make_unique<CHyprNstackLayout>();
     static auto MWCB = HyprlandAPI::registerCallbackDynamic(PHANDLE, "moveWorkspace", moveWorkspaceCallback);
+    static auto CRCB = HyprlandAPI::registerCallbackDynamic(PHANDLE, "configReloaded", configReloadedCallback);
+    static auto PRCB = HyprlandAPI::registerCallbackDynamic(PHANDLE, "preRender", preRenderCallback);
+
+    HyprlandAPI::registerHyprCtlCommand(PHANDLE, SHyprCtlCommand{.name = "nstack", .exact = false, .fn = nstackCtlCommand});
 
     static auto DWCB = HyprlandAPI::registerCallbackDynamic(PHANDLE, "destroyWorkspace", [&](void* self, SCallbackInfo&, std::any data) {
         CWorkspace* ws = std::any_cast<CWorkspace*>(data);
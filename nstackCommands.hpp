@@ -0,0 +1,151 @@
+#pragma once
+
+// layoutmsg command table.
+// Commands are looked up through a seeded FNV-1a hash; the seed is searched at compile time
+// so every command lands in its own slot, making a lookup one hash and one string compare.
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+enum eNstackCommand : uint8_t {
+    NSTACK_CMD_INVALID = 0,
+    NSTACK_CMD_SWAPWITHMASTER,
+    NSTACK_CMD_FOCUSMASTER,
+    NSTACK_CMD_CYCLENEXT,
+    NSTACK_CMD_CYCLEPREV,
+    NSTACK_CMD_SWAPNEXT,
+    NSTACK_CMD_SWAPPREV,
+    NSTACK_CMD_FOCUSDIR,
+    NSTACK_CMD_SWAPDIR,
+    NSTACK_CMD_ADDMASTER,
+    NSTACK_CMD_REMOVEMASTER,
+    NSTACK_CMD_TOGGLEMASTER,
+    NSTACK_CMD_ORIENTATIONLEFT,
+    NSTACK_CMD_ORIENTATIONRIGHT,
+    NSTACK_CMD_ORIENTATIONTOP,
+    NSTACK_CMD_ORIENTATIONBOTTOM,
+    NSTACK_CMD_ORIENTATIONHCENTER,
+    NSTACK_CMD_ORIENTATIONVCENTER,
+    NSTACK_CMD_ORIENTATIONNEXT,
+    NSTACK_CMD_ORIENTATIONPREV,
+    NSTACK_CMD_ORIENTATIONCYCLE,
+    NSTACK_CMD_RESETSPLITS,
+    NSTACK_CMD_RESETOVERRIDES,
+    NSTACK_CMD_SETSTACKCOUNT,
+    NSTACK_CMD_ORDERROW,
+    NSTACK_CMD_ORDERCOLUMN,
+    NSTACK_CMD_ORDERRROW,
+    NSTACK_CMD_ORDERRCOLUMN,
+    NSTACK_CMD_ORDERNEXT,
+    NSTACK_CMD_ORDERPREV,
+    NSTACK_CMD_MFACT,
+    NSTACK_CMD_TOGGLEMFACT,
+    NSTACK_CMD_SET,
+    NSTACK_CMD_TRACE,
+    NSTACK_CMD_TRACEDUMP,
+    NSTACK_CMD_RECORD,
+};
+
+struct SNstackCommand {
+    std::string_view name;
+    eNstackCommand   command;
+};
+
+inline constexpr SNstackCommand NSTACK_COMMANDS[] = {
+    {"swapwithmaster", NSTACK_CMD_SWAPWITHMASTER},
+    {"focusmaster", NSTACK_CMD_FOCUSMASTER},
+    {"cyclenext", NSTACK_CMD_CYCLENEXT},
+    {"cycleprev", NSTACK_CMD_CYCLEPREV},
+    {"swapnext", NSTACK_CMD_SWAPNEXT},
+    {"swapprev", NSTACK_CMD_SWAPPREV},
+    {"focusdir", NSTACK_CMD_FOCUSDIR},
+    {"swapdir", NSTACK_CMD_SWAPDIR},
+    {"addmaster", NSTACK_CMD_ADDMASTER},
+    {"removemaster", NSTACK_CMD_REMOVEMASTER},
+    {"togglemaster", NSTACK_CMD_TOGGLEMASTER},
+    {"orientationleft", NSTACK_CMD_ORIENTATIONLEFT},
+    {"orientationright", NSTACK_CMD_ORIENTATIONRIGHT},
+    {"orientationtop", NSTACK_CMD_ORIENTATIONTOP},
+    {"orientationbottom", NSTACK_CMD_ORIENTATIONBOTTOM},
+    {"orientationcenter", NSTACK_CMD_ORIENTATIONHCENTER},
+    {"orientationhcenter", NSTACK_CMD_ORIENTATIONHCENTER},
+    {"orientationvcenter", NSTACK_CMD_ORIENTATIONVCENTER},
+    {"orientationnext", NSTACK_CMD_ORIENTATIONNEXT},
+    {"orientationprev", NSTACK_CMD_ORIENTATIONPREV},
+    {"orientationcycle", NSTACK_CMD_ORIENTATIONCYCLE},
+    {"resetsplits", NSTACK_CMD_RESETSPLITS},
+    {"resetoverrides", NSTACK_CMD_RESETOVERRIDES},
+    {"setstackcount", NSTACK_CMD_SETSTACKCOUNT},
+    {"orderrow", NSTACK_CMD_ORDERROW},
+    {"ordercolumn", NSTACK_CMD_ORDERCOLUMN},
+    {"orderrrow", NSTACK_CMD_ORDERRROW},
+    {"orderrcolumn", NSTACK_CMD_ORDERRCOLUMN},
+    {"ordernext", NSTACK_CMD_ORDERNEXT},
+    {"orderprev", NSTACK_CMD_ORDERPREV},
+    {"mfact", NSTACK_CMD_MFACT},
+    {"togglemfact", NSTACK_CMD_TOGGLEMFACT},
+    {"set", NSTACK_CMD_SET},
+    {"trace", NSTACK_CMD_TRACE},
+    {"tracedump", NSTACK_CMD_TRACEDUMP},
+    {"record", NSTACK_CMD_RECORD},
+};
+
+inline constexpr size_t NSTACK_COMMAND_SLOTS = 256;
+
+constexpr uint32_t nstackCommandHash(std::string_view str, uint32_t seed) {
+    uint32_t hash = 2166136261u ^ seed;
+    for (const char c : str) {
+        hash ^= (uint8_t)c;
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+constexpr bool nstackCommandSeedIsPerfect(uint32_t seed) {
+    std::array<bool, NSTACK_COMMAND_SLOTS> used{};
+    for (const auto& c : NSTACK_COMMANDS) {
+        auto& slot = used[nstackCommandHash(c.name, seed) % NSTACK_COMMAND_SLOTS];
+        if (slot)
+            return false;
+        slot = true;
+    }
+    return true;
+}
+
+constexpr uint32_t nstackFindCommandSeed() {
+    for (uint32_t seed = 0; seed < 100000; ++seed) {
+        if (nstackCommandSeedIsPerfect(seed))
+            return seed;
+    }
+    return UINT32_MAX;
+}
+
+inline constexpr uint32_t NSTACK_COMMAND_SEED = nstackFindCommandSeed();
+static_assert(NSTACK_COMMAND_SEED != UINT32_MAX, "no collision free seed for the layoutmsg commands, raise NSTACK_COMMAND_SLOTS");
+
+// slot -> index into NSTACK_COMMANDS + 1, 0 is empty
+constexpr std::array<uint8_t, NSTACK_COMMAND_SLOTS> nstackBuildCommandSlots() {
+    std::array<uint8_t, NSTACK_COMMAND_SLOTS> slots{};
+    for (size_t i = 0; i < std::size(NSTACK_COMMANDS); ++i)
+        slots[nstackCommandHash(NSTACK_COMMANDS[i].name, NSTACK_COMMAND_SEED) % NSTACK_COMMAND_SLOTS] = i + 1;
+    return slots;
+}
+
+inline constexpr auto NSTACK_COMMAND_SLOT_TABLE = nstackBuildCommandSlots();
+
+constexpr eNstackCommand nstackLookupCommand(std::string_view name) {
+    const auto SLOT = NSTACK_COMMAND_SLOT_TABLE[nstackCommandHash(name, NSTACK_COMMAND_SEED) % NSTACK_COMMAND_SLOTS];
+    if (!SLOT || NSTACK_COMMANDS[SLOT - 1].name != name)
+        return NSTACK_CMD_INVALID;
+    return NSTACK_COMMANDS[SLOT - 1].command;
+}
+
+constexpr bool nstackCommandTableIsConsistent() {
+    for (const auto& c : NSTACK_COMMANDS) {
+        if (nstackLookupCommand(c.name) != c.command)
+            return false;
+    }
+    return nstackLookupCommand("batch") == NSTACK_CMD_INVALID && nstackLookupCommand("") == NSTACK_CMD_INVALID;
+}
+static_assert(nstackCommandTableIsConsistent());
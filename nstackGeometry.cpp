@@ -0,0 +1,353 @@
+#include "nstackGeometry.hpp"
+#include <algorithm>
+#include <cstring>
+
+static SNstackVec xFactorMargin(const SNstackGeometry& geom) {
+    const auto& OPTS        = geom.options;
+    const auto  ORIENTATION = OPTS.orientation;
+
+    if (OPTS.x_factor <= 0.0f || OPTS.x_factor >= 1.0f)
+        return SNstackVec(0.0f, 0.0f);
+
+    return SNstackVec(ORIENTATION % 2 == 0 ? (1.0f - OPTS.x_factor) * geom.monitorSize.x / 2.f : 0.0f,
+                      ORIENTATION % 2 == 1 ? (1.0f - OPTS.x_factor) * geom.monitorSize.y / 2.f : 0.0f);
+}
+
+void nstackReservedArea(const SNstackGeometry& geom, SNstackVec& topLeft, SNstackVec& bottomRight) {
+    const auto MARGIN = xFactorMargin(geom);
+
+    topLeft     = geom.reservedTopLeft + MARGIN;
+    bottomRight = geom.reservedBottomRight + MARGIN;
+}
+
+bool nstackComputeGeometry(SNstackGeometry& geom) {
+    const auto&          OPTS      = geom.options;
+    const auto           MONPOS    = geom.monitorPosition;
+    const auto           MONSIZE   = geom.monitorSize;
+    auto                 NUMSTACKS = OPTS.stackCount;
+    auto&                nodes     = geom.nodes;
+
+    SNstackGeometryNode* PMASTERNODE = nullptr;
+    int                  MASTERS     = 0;
+    for (auto& n : nodes) {
+        if (!n.isMaster)
+            continue;
+        if (!PMASTERNODE)
+            PMASTERNODE = &n;
+        MASTERS++;
+    }
+
+    if (!PMASTERNODE)
+        return false;
+
+    const int       NODECOUNT   = nodes.size();
+    const auto      ONLYMASTERS = !(NODECOUNT - MASTERS);
+
+    eColOrientation orientation = OPTS.orientation;
+    eColOrder       order       = OPTS.order;
+
+    auto            MCONTAINERPOS  = SNstackVec(0.0f, 0.0f);
+    auto            MCONTAINERSIZE = SNstackVec(0.0f, 0.0f);
+    const auto      MARGIN         = xFactorMargin(geom);
+    const auto      TOPLEFT        = geom.reservedTopLeft + MARGIN;
+    const auto      BOTTOMRIGHT    = geom.reservedBottomRight + MARGIN;
+
+    if (NUMSTACKS < 3 && orientation > NSTACK_ORIENTATION_BOTTOM) {
+        NUMSTACKS = 3;
+    }
+
+    if (!PMASTERNODE->masterAdjusted) {
+        if (NODECOUNT < NUMSTACKS) {
+            PMASTERNODE->percMaster = OPTS.master_factor ? OPTS.master_factor : 1.0f / NODECOUNT;
+        } else {
+            PMASTERNODE->percMaster = OPTS.master_factor ? OPTS.master_factor : 1.0f / (NUMSTACKS);
+        }
+    }
+    bool centerMasterWindow = false;
+    if (OPTS.center_single_master)
+        centerMasterWindow = true;
+    if (!ONLYMASTERS && NODECOUNT - MASTERS < 2) {
+        if (orientation == NSTACK_ORIENTATION_HCENTER) {
+            orientation = NSTACK_ORIENTATION_LEFT;
+        } else if (orientation == NSTACK_ORIENTATION_VCENTER) {
+            orientation = NSTACK_ORIENTATION_TOP;
+        }
+    }
+
+    if (ONLYMASTERS) {
+        if (centerMasterWindow) {
+
+            if (!PMASTERNODE->masterAdjusted)
+                PMASTERNODE->percMaster = OPTS.single_master_factor ? OPTS.single_master_factor : 0.5f;
+
+            if (orientation == NSTACK_ORIENTATION_TOP || orientation == NSTACK_ORIENTATION_BOTTOM) {
+                const float HEIGHT        = (MONSIZE.y - TOPLEFT.y - BOTTOMRIGHT.y) * PMASTERNODE->percMaster;
+                float       CENTER_OFFSET = (MONSIZE.y - HEIGHT) / 2;
+                MCONTAINERSIZE            = SNstackVec(MONSIZE.x - TOPLEFT.x - BOTTOMRIGHT.x, HEIGHT);
+                MCONTAINERPOS             = TOPLEFT + MONPOS + SNstackVec(0.0, CENTER_OFFSET);
+            } else {
+                const float WIDTH         = (MONSIZE.x - TOPLEFT.x - BOTTOMRIGHT.x) * PMASTERNODE->percMaster;
+                float       CENTER_OFFSET = (MONSIZE.x - WIDTH) / 2;
+                MCONTAINERSIZE            = SNstackVec(WIDTH, MONSIZE.y - TOPLEFT.y - BOTTOMRIGHT.y);
+                MCONTAINERPOS             = TOPLEFT + MONPOS + SNstackVec(CENTER_OFFSET, 0.0);
+            }
+        } else {
+            MCONTAINERPOS  = TOPLEFT + MONPOS;
+            MCONTAINERSIZE = SNstackVec(MONSIZE.x - TOPLEFT.x - BOTTOMRIGHT.x, MONSIZE.y - BOTTOMRIGHT.y - TOPLEFT.y);
+        }
+    } else {
+        const float MASTERSIZE =
+            orientation % 2 == 0 ? (MONSIZE.x - TOPLEFT.x - BOTTOMRIGHT.x) * PMASTERNODE->percMaster : (MONSIZE.y - TOPLEFT.y - BOTTOMRIGHT.y) * PMASTERNODE->percMaster;
+
+        if (orientation == NSTACK_ORIENTATION_RIGHT) {
+            MCONTAINERPOS  = TOPLEFT + MONPOS + SNstackVec(MONSIZE.x - MASTERSIZE - BOTTOMRIGHT.x - TOPLEFT.x, 0.0f);
+            MCONTAINERSIZE = SNstackVec(MASTERSIZE, MONSIZE.y - BOTTOMRIGHT.y - TOPLEFT.y);
+        } else if (orientation == NSTACK_ORIENTATION_LEFT) {
+            MCONTAINERPOS  = TOPLEFT + MONPOS;
+            MCONTAINERSIZE = SNstackVec(MASTERSIZE, MONSIZE.y - BOTTOMRIGHT.y - TOPLEFT.y);
+        } else if (orientation == NSTACK_ORIENTATION_TOP) {
+            MCONTAINERPOS  = TOPLEFT + MONPOS;
+            MCONTAINERSIZE = SNstackVec(MONSIZE.x - BOTTOMRIGHT.x - TOPLEFT.x, MASTERSIZE);
+        } else if (orientation == NSTACK_ORIENTATION_BOTTOM) {
+            MCONTAINERPOS  = TOPLEFT + MONPOS + SNstackVec(0.0f, MONSIZE.y - MASTERSIZE - BOTTOMRIGHT.y - TOPLEFT.y);
+            MCONTAINERSIZE = SNstackVec(MONSIZE.x - BOTTOMRIGHT.x - TOPLEFT.x, MASTERSIZE);
+
+        } else if (orientation == NSTACK_ORIENTATION_HCENTER) {
+            float CENTER_OFFSET = (MONSIZE.x - MASTERSIZE - 2.f * MARGIN.x) / 2;
+            MCONTAINERSIZE      = SNstackVec(MASTERSIZE, MONSIZE.y - TOPLEFT.y - BOTTOMRIGHT.y);
+            MCONTAINERPOS       = TOPLEFT + MONPOS + SNstackVec(CENTER_OFFSET, 0.0);
+        } else if (orientation == NSTACK_ORIENTATION_VCENTER) {
+            float CENTER_OFFSET = (MONSIZE.y - MASTERSIZE - 2.f * MARGIN.y) / 2;
+            MCONTAINERSIZE      = SNstackVec(MONSIZE.x - TOPLEFT.x - BOTTOMRIGHT.x, MASTERSIZE);
+            MCONTAINERPOS       = TOPLEFT + MONPOS + SNstackVec(0.0, CENTER_OFFSET);
+        }
+    }
+
+    if (MCONTAINERSIZE != SNstackVec(0, 0)) {
+        float       nodeSpaceLeft = orientation % 2 == 0 ? MCONTAINERSIZE.y : MCONTAINERSIZE.x;
+        int         nodesLeft     = MASTERS;
+        float       nextNodeCoord = 0;
+        const float MASTERSIZE    = orientation % 2 == 0 ? MCONTAINERSIZE.x : MCONTAINERSIZE.y;
+        for (auto& n : nodes) {
+            if (!n.isMaster)
+                continue;
+
+            if (orientation % 2 == 0)
+                n.position = MCONTAINERPOS + SNstackVec(0.0, nextNodeCoord);
+            else
+                n.position = MCONTAINERPOS + SNstackVec(nextNodeCoord, 0.0);
+
+            float NODESIZE = nodesLeft > 1 ? nodeSpaceLeft / nodesLeft * n.percSize : nodeSpaceLeft;
+            if (NODESIZE > nodeSpaceLeft * 0.9f && nodesLeft > 1)
+                NODESIZE = nodeSpaceLeft * 0.9f;
+
+            n.size = orientation % 2 == 0 ? SNstackVec(MASTERSIZE, NODESIZE) : SNstackVec(NODESIZE, MASTERSIZE);
+            nodesLeft--;
+            nodeSpaceLeft -= NODESIZE;
+            nextNodeCoord += NODESIZE;
+        }
+    }
+
+    //compute placement of slave window(s)
+    int slavesLeft  = NODECOUNT - MASTERS;
+    int slavesTotal = slavesLeft;
+    if (slavesTotal < 1)
+        return true;
+    int numStacks      = slavesTotal > NUMSTACKS - 1 ? NUMSTACKS - 1 : slavesTotal;
+    int numStackBefore = numStacks / 2 + numStacks % 2;
+    int numStackAfter  = numStacks / 2;
+
+    geom.stackNodeCount.assign(numStacks + 1, 0);
+    geom.stackPercs.resize(numStacks + 1, 1.0f);
+
+    float                   stackNodeSizeLeft = orientation % 2 == 1 ? MONSIZE.x - BOTTOMRIGHT.x - TOPLEFT.x : MONSIZE.y - BOTTOMRIGHT.y - TOPLEFT.y;
+
+    int                     stackNum = 0;
+    std::vector<float>      nodeSpaceLeft(numStacks, stackNodeSizeLeft);
+    std::vector<float>      nodeNextCoord(numStacks, 0);
+    std::vector<SNstackVec> stackCoords(numStacks, SNstackVec(0, 0));
+
+    const float             STACKSIZE = orientation % 2 == 1 ? (MONSIZE.y - BOTTOMRIGHT.y - TOPLEFT.y - PMASTERNODE->size.y) / numStacks :
+                                                               (MONSIZE.x - BOTTOMRIGHT.x - TOPLEFT.x - PMASTERNODE->size.x) / numStacks;
+
+    const float             STACKSIZEBEFORE = numStackBefore ? ((STACKSIZE * numStacks) / 2) / numStackBefore : 0.0f;
+    const float             STACKSIZEAFTER  = numStackAfter ? ((STACKSIZE * numStacks) / 2) / numStackAfter : 0.0f;
+
+    //Pre calculate each stack's coordinates so we can take into account manual resizing
+    if (orientation == NSTACK_ORIENTATION_LEFT || orientation == NSTACK_ORIENTATION_TOP) {
+        numStackBefore = 0;
+        numStackAfter  = numStacks;
+    } else if (orientation == NSTACK_ORIENTATION_RIGHT || orientation == NSTACK_ORIENTATION_BOTTOM) {
+        numStackAfter  = 0;
+        numStackBefore = numStacks;
+    }
+
+    for (int i = 0; i < numStacks; i++) {
+        float useSize = STACKSIZE;
+        if (orientation > NSTACK_ORIENTATION_BOTTOM) {
+            if (i < numStackBefore)
+                useSize = STACKSIZEBEFORE;
+            else
+                useSize = STACKSIZEAFTER;
+        }
+
+        //The Vector here isn't 'x,y', it is 'stack start, stack end'
+        double coordAdjust = 0;
+        if (i == numStackBefore && numStackAfter) {
+            coordAdjust = orientation % 2 == 1 ? PMASTERNODE->position.y + PMASTERNODE->size.y - MONPOS.y - TOPLEFT.y :
+                                                 PMASTERNODE->position.x + PMASTERNODE->size.x - MONPOS.x - TOPLEFT.x;
+        }
+        float monMax     = orientation % 2 == 1 ? MONSIZE.y - TOPLEFT.y - BOTTOMRIGHT.y : MONSIZE.x - TOPLEFT.x - BOTTOMRIGHT.x;
+        float stackStart = 0.0f;
+        if (i == numStackBefore && numStackAfter) {
+            stackStart = coordAdjust;
+        } else if (i) {
+            stackStart = stackCoords[i - 1].y;
+        }
+        float scaledSize = useSize * geom.stackPercs[i + 1];
+
+        //Stacks at bottom and right always fill remaining space
+        //Stacks that end adjacent to the master stack are pinned to it
+
+        if (orientation == NSTACK_ORIENTATION_LEFT && i >= numStacks - 1) {
+            scaledSize = monMax - stackStart;
+        } else if (orientation == NSTACK_ORIENTATION_RIGHT && i >= numStacks - 1) {
+            scaledSize = (PMASTERNODE->position.x - MONPOS.x - TOPLEFT.x) - stackStart;
+        } else if (orientation == NSTACK_ORIENTATION_TOP && i >= numStacks - 1) {
+            scaledSize = monMax - stackStart;
+        } else if (orientation == NSTACK_ORIENTATION_BOTTOM && i >= numStacks - 1) {
+            scaledSize = (PMASTERNODE->position.y - MONPOS.y - TOPLEFT.y) - stackStart;
+        } else if (orientation == NSTACK_ORIENTATION_HCENTER) {
+            if (i >= numStacks - 1) {
+                scaledSize = monMax - stackStart;
+            } else if (i == numStacks - 2) {
+                scaledSize = (PMASTERNODE->position.x - MONPOS.x - TOPLEFT.x) - stackStart;
+            }
+        } else if (orientation == NSTACK_ORIENTATION_VCENTER) {
+            if (i >= numStacks - 1) {
+                scaledSize = monMax - stackStart;
+            } else if (i == numStacks - 2) {
+                scaledSize = (PMASTERNODE->position.y - MONPOS.y - TOPLEFT.y) - stackStart;
+            }
+        }
+        stackCoords[i] = SNstackVec(stackStart, stackStart + scaledSize);
+    }
+
+    if (order > NSTACK_ORDER_COLUMN)
+        std::reverse(stackCoords.begin(), stackCoords.end());
+
+    for (auto& nd : nodes) {
+        if (nd.isMaster)
+            continue;
+
+        SNstackVec stackPos = stackCoords[stackNum];
+        if (orientation % 2 == 0) {
+            nd.position = TOPLEFT + MONPOS + SNstackVec(stackPos.x, nodeNextCoord[stackNum]);
+        } else {
+            nd.position = TOPLEFT + MONPOS + SNstackVec(nodeNextCoord[stackNum], stackPos.x);
+        }
+
+        int nodeDiv = slavesTotal / numStacks;
+        if (slavesTotal % numStacks && stackNum < slavesTotal % numStacks)
+            nodeDiv++;
+        float NODESIZE = slavesLeft > numStacks ? (stackNodeSizeLeft / nodeDiv) * nd.percSize : nodeSpaceLeft[stackNum];
+        if (NODESIZE > nodeSpaceLeft[stackNum] * 0.9f && slavesLeft > numStacks)
+            NODESIZE = nodeSpaceLeft[stackNum] * 0.9f;
+
+        if (order % 2 && (int)geom.stackNodeCount.size() > nd.stackNum) {
+            NODESIZE = geom.stackNodeCount[nd.stackNum] < nodeDiv - 1 ? (stackNodeSizeLeft / nodeDiv) * nd.percSize : nodeSpaceLeft[stackNum];
+            if (NODESIZE > nodeSpaceLeft[stackNum] * 0.9f && geom.stackNodeCount[nd.stackNum] < nodeDiv - 1)
+                NODESIZE = nodeSpaceLeft[stackNum] * 0.9f;
+        }
+
+        nd.stackNum = stackNum + 1;
+        nd.size     = orientation % 2 == 1 ? SNstackVec(NODESIZE, stackPos.y - stackPos.x) : SNstackVec(stackPos.y - stackPos.x, NODESIZE);
+        geom.stackNodeCount[nd.stackNum]++;
+        slavesLeft--;
+        nodeSpaceLeft[stackNum] -= NODESIZE;
+        nodeNextCoord[stackNum] += NODESIZE;
+        if (order % 2 == 0)
+            stackNum = (slavesTotal - slavesLeft) % numStacks;
+        else if (slavesLeft < numStacks - stackNum)
+            stackNum = numStacks - slavesLeft;
+        else if (nodeSpaceLeft[stackNum] < 1 && stackNum < numStacks - 1)
+            stackNum++;
+    }
+
+    return true;
+}
+
+void SNstackBoxes::resize(size_t count_) {
+    count = count_;
+
+    // padded to whole vectors so the kernel has no scalar tail
+    const size_t PADDED = (count + NSTACK_BOX_LANES - 1) / NSTACK_BOX_LANES * NSTACK_BOX_LANES;
+    for (auto* v : {&x, &y, &w, &h, &reservedLeft, &reservedTop, &reservedRight, &reservedBottom})
+        v->resize(PADDED);
+}
+
+// one SSE2 or AVX register of doubles
+typedef double vdouble __attribute__((vector_size(NSTACK_BOX_LANES * sizeof(double))));
+
+static vdouble splat(double v) {
+    return v - vdouble{};
+}
+
+static vdouble load(const std::vector<double>& from, size_t i) {
+    vdouble v;
+    memcpy(&v, &from[i], sizeof(v));
+    return v;
+}
+
+static void store(std::vector<double>& to, size_t i, vdouble v) {
+    memcpy(&to[i], &v, sizeof(v));
+}
+
+// gapOut where the edge is within Hyprland's STICKS tolerance (2px) of the usable area, gapIn elsewhere
+static vdouble edgeGap(vdouble edge, vdouble area, vdouble gapIn, vdouble gapOut) {
+    const vdouble D = edge - area;
+    return ((D < 2.0) & (D > -2.0)) ? gapOut : gapIn;
+}
+
+void nstackApplyGaps(SNstackBoxes& boxes, const SNstackGapOptions& opts) {
+    const vdouble LEFT   = splat(opts.areaTopLeft.x);
+    const vdouble TOP    = splat(opts.areaTopLeft.y);
+    const vdouble RIGHT  = splat(opts.areaBottomRight.x);
+    const vdouble BOTTOM = splat(opts.areaBottomRight.y);
+    const vdouble SCALE  = splat(opts.scale);
+
+    const vdouble INLEFT    = splat(opts.gapsIn.left);
+    const vdouble INTOP     = splat(opts.gapsIn.top);
+    const vdouble INRIGHT   = splat(opts.gapsIn.right);
+    const vdouble INBOTTOM  = splat(opts.gapsIn.bottom);
+    const vdouble OUTLEFT   = splat(opts.gapsOut.left);
+    const vdouble OUTTOP    = splat(opts.gapsOut.top);
+    const vdouble OUTRIGHT  = splat(opts.gapsOut.right);
+    const vdouble OUTBOTTOM = splat(opts.gapsOut.bottom);
+
+    for (size_t i = 0; i < boxes.count; i += NSTACK_BOX_LANES) {
+        const vdouble X  = load(boxes.x, i);
+        const vdouble Y  = load(boxes.y, i);
+        const vdouble W  = load(boxes.w, i);
+        const vdouble H  = load(boxes.h, i);
+        const vdouble RL = load(boxes.reservedLeft, i);
+        const vdouble RT = load(boxes.reservedTop, i);
+        const vdouble RR = load(boxes.reservedRight, i);
+        const vdouble RB = load(boxes.reservedBottom, i);
+
+        const vdouble GAPLEFT   = edgeGap(X, LEFT, INLEFT, OUTLEFT);
+        const vdouble GAPTOP    = edgeGap(Y, TOP, INTOP, OUTTOP);
+        const vdouble GAPRIGHT  = edgeGap(X + W, RIGHT, INRIGHT, OUTRIGHT);
+        const vdouble GAPBOTTOM = edgeGap(Y + H, BOTTOM, INBOTTOM, OUTBOTTOM);
+
+        const vdouble POSX  = X + GAPLEFT + RL;
+        const vdouble POSY  = Y + GAPTOP + RT;
+        const vdouble SIZEX = W - GAPLEFT - GAPRIGHT - (RL + RR);
+        const vdouble SIZEY = H - GAPTOP - GAPBOTTOM - (RT + RB);
+
+        store(boxes.x, i, POSX + (SIZEX - SIZEX * SCALE) / 2.0);
+        store(boxes.y, i, POSY + (SIZEY - SIZEY * SCALE) / 2.0);
+        store(boxes.w, i, SIZEX * SCALE);
+        store(boxes.h, i, SIZEY * SCALE);
+    }
+}
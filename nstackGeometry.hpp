@@ -0,0 +1,127 @@
+#pragma once
+
+// Pure rectangle computation for the nstack layout.
+// This header (and nstackGeometry.cpp) must not depend on Hyprland so the
+// geometry can be benchmarked and exercised without a running compositor.
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+//orientation determines which side of the screen the master area resides
+enum eColOrientation : uint8_t {
+    NSTACK_ORIENTATION_LEFT = 0,
+    NSTACK_ORIENTATION_TOP,
+    NSTACK_ORIENTATION_RIGHT,
+    NSTACK_ORIENTATION_BOTTOM,
+    NSTACK_ORIENTATION_HCENTER,
+    NSTACK_ORIENTATION_VCENTER,
+};
+
+// order determines how slave windows are filled in
+// e.g. if orientation is left, order would be:
+// ROW:     COLUMN:  RROW:    RCOLUMN:
+// 123      135      321      531
+// 456      246      654      642
+enum eColOrder : uint8_t {
+    NSTACK_ORDER_ROW = 0, // rows first (default)
+    NSTACK_ORDER_COLUMN,  // columns first
+    NSTACK_ORDER_RROW,    // rows first, mirrored
+    NSTACK_ORDER_RCOLUMN, // columns first, mirrored
+};
+
+struct SNstackVec {
+    double x = 0;
+    double y = 0;
+
+    SNstackVec() = default;
+    SNstackVec(double x_, double y_) : x(x_), y(y_) {}
+
+    SNstackVec operator+(const SNstackVec& rhs) const {
+        return {x + rhs.x, y + rhs.y};
+    }
+    SNstackVec operator-(const SNstackVec& rhs) const {
+        return {x - rhs.x, y - rhs.y};
+    }
+    bool operator==(const SNstackVec& rhs) const {
+        return x == rhs.x && y == rhs.y;
+    }
+};
+
+// the subset of SNstackWorkspaceData the geometry depends on
+struct SNstackGeometryOptions {
+    int             stackCount           = 2;
+    bool            center_single_master = false;
+    float           master_factor        = 0.0f;
+    float           single_master_factor = 0.5f;
+    float           x_factor             = 0.0f;
+    eColOrientation orientation          = NSTACK_ORIENTATION_LEFT;
+    eColOrder       order                = NSTACK_ORDER_ROW;
+
+    bool            operator==(const SNstackGeometryOptions&) const = default;
+};
+
+// the subset of SNstackNodeData the geometry depends on.
+// percMaster (first master only), stackNum, position and size are updated in place.
+struct SNstackGeometryNode {
+    bool       isMaster       = false;
+    bool       masterAdjusted = false;
+    float      percMaster     = 0.5f;
+    float      percSize       = 1.f;
+    int        stackNum       = 0;
+
+    SNstackVec position;
+    SNstackVec size;
+};
+
+struct SNstackGeometry {
+    SNstackVec                       monitorPosition;
+    SNstackVec                       monitorSize;
+    SNstackVec                       reservedTopLeft;
+    SNstackVec                       reservedBottomRight;
+    SNstackGeometryOptions           options;
+
+    std::vector<SNstackGeometryNode> nodes; // layout order, masters and slaves interleaved
+    std::vector<float>               stackPercs;
+    std::vector<int>                 stackNodeCount;
+};
+
+// reserved area including the x_factor margins
+void nstackReservedArea(const SNstackGeometry& geom, SNstackVec& topLeft, SNstackVec& bottomRight);
+
+// computes the box of every node in geom.nodes.
+// Returns false (leaving the nodes untouched) if there is no master to lay out.
+bool nstackComputeGeometry(SNstackGeometry& geom);
+
+// doubles per vector in nstackApplyGaps
+#ifdef __AVX__
+inline constexpr size_t NSTACK_BOX_LANES = 4;
+#else
+inline constexpr size_t NSTACK_BOX_LANES = 2;
+#endif
+
+// a workspace's boxes as parallel arrays, for nstackApplyGaps
+struct SNstackBoxes {
+    size_t              count = 0;
+    std::vector<double> x, y, w, h;
+    // area reserved by the window's decorations
+    std::vector<double> reservedLeft, reservedTop, reservedRight, reservedBottom;
+
+    void                resize(size_t count);
+};
+
+struct SNstackGaps {
+    double top = 0, right = 0, bottom = 0, left = 0;
+};
+
+struct SNstackGapOptions {
+    SNstackGaps gapsIn;
+    SNstackGaps gapsOut;
+    SNstackVec  areaTopLeft;     // usable monitor area, absolute
+    SNstackVec  areaBottomRight; // ^
+    double      scale = 1.0;     // special_scale_factor, scaled around the centre
+};
+
+// turns layout boxes into window boxes in place: gaps_out on edges touching the usable area and
+// gaps_in elsewhere, minus the reserved area, then scaled. Explicitly vectorized, NSTACK_BOX_LANES boxes at a time.
+void nstackApplyGaps(SNstackBoxes& boxes, const SNstackGapOptions& opts);
@@ -6,214 +6,248 @@
 #include <format>
 #include <hyprland/src/render/decorations/IHyprWindowDecoration.hpp>
 #include <algorithm>
+#include <charconv>
+#include <ranges>
+#include <utility>
 
 SNstackNodeData* CHyprNstackLayout::getNodeFromWindow(PHLWINDOW pWindow) {
-    for (auto& nd : m_lMasterNodesData) {
-        if (nd.pWindow.lock() == pWindow)
-            return &nd;
-    }
+    if (!pWindow)
+        return nullptr;
 
-    return nullptr;
+    const auto IT = m_mWindowNodes.find(pWindow.get());
+    if (IT == m_mWindowNodes.end())
+        return nullptr;
+
+    const auto PNODE = m_cNodes.get(IT->second);
+    return PNODE && PNODE->pWindow.lock() == pWindow ? PNODE : nullptr;
 }
 
-int CHyprNstackLayout::getNodesOnWorkspace(const int& ws) {
-    int no = 0;
-    for (auto& n : m_lMasterNodesData) {
-        if (n.workspaceID == ws)
-            no++;
-    }
+SNstackNodeData* CHyprNstackLayout::getNode(const SNstackHandle& handle) {
+    return m_cNodes.get(handle);
+}
+
+const std::vector<SNstackHandle>& CHyprNstackLayout::getWorkspaceHandles(const int& ws) {
+    static const std::vector<SNstackHandle> EMPTY;
 
-    return no;
+    const auto                              IT = m_mWorkspaceNodes.find(ws);
+    return IT == m_mWorkspaceNodes.end() ? EMPTY : IT->second.nodes;
+}
+
+// the nodes of ws in layout order, handles that went stale are skipped
+auto CHyprNstackLayout::getWorkspaceNodes(const int& ws) {
+    return getWorkspaceHandles(ws) | std::views::transform([this](const SNstackHandle& h) { return getNode(h); }) |
+        std::views::filter([](const SNstackNodeData* n) { return n != nullptr; });
+}
+
+int CHyprNstackLayout::getNodesOnWorkspace(const int& ws) {
+    return getWorkspaceHandles(ws).size();
 }
 
 int CHyprNstackLayout::getMastersOnWorkspace(const int& ws) {
-    int no = 0;
-    for (auto& n : m_lMasterNodesData) {
-        if (n.workspaceID == ws && n.isMaster)
-            no++;
+    const auto IT = m_mWorkspaceNodes.find(ws);
+    return IT == m_mWorkspaceNodes.end() ? 0 : IT->second.masters;
+}
+
+SNstackNodeData* CHyprNstackLayout::addNode(PHLWINDOW pWindow, const int& ws, bool front) {
+    const auto [HANDLE, PNODE] = m_cNodes.emplace();
+
+    PNODE->workspaceID = ws;
+    PNODE->pWindow     = pWindow;
+    PNODE->handle      = HANDLE;
+
+    m_mWindowNodes[pWindow.get()] = HANDLE;
+
+    auto& wsNodes        = m_mWorkspaceNodes[ws];
+    wsNodes.kindsValid   = false;
+    wsNodes.spatialValid = false;
+    wsNodes.generation   = ++m_iNodeGeneration;
+    if (front)
+        wsNodes.nodes.insert(wsNodes.nodes.begin(), HANDLE);
+    else
+        wsNodes.nodes.push_back(HANDLE);
+
+    return PNODE;
+}
+
+void CHyprNstackLayout::removeNode(PHLWINDOW pWindow) {
+    const auto IT = m_mWindowNodes.find(pWindow.get());
+    if (IT == m_mWindowNodes.end())
+        return;
+
+    const auto PNODE = m_cNodes.get(IT->second);
+    if (!PNODE) {
+        m_mWindowNodes.erase(IT);
+        return;
+    }
+
+    if (const auto WSIT = m_mWorkspaceNodes.find(PNODE->workspaceID); WSIT != m_mWorkspaceNodes.end()) {
+        std::erase(WSIT->second.nodes, IT->second);
+        WSIT->second.kindsValid   = false;
+        WSIT->second.spatialValid = false;
+        WSIT->second.generation   = ++m_iNodeGeneration;
+        if (PNODE->isMaster)
+            WSIT->second.masters--;
+        if (WSIT->second.nodes.empty())
+            m_mWorkspaceNodes.erase(WSIT);
     }
 
-    return no;
+    m_cNodes.erase(IT->second);
+    m_mWindowNodes.erase(IT);
+}
+
+void CHyprNstackLayout::setNodeMaster(SNstackNodeData* pNode, bool master) {
+    if (pNode->isMaster == master)
+        return;
+
+    pNode->isMaster = master;
+    if (!master)
+        pNode->restoredMaster = false;
+
+    auto& wsNodes      = m_mWorkspaceNodes[pNode->workspaceID];
+    wsNodes.kindsValid = false;
+    wsNodes.generation = ++m_iNodeGeneration;
+    wsNodes.masters += master ? 1 : -1;
+}
+
+// the nodes of ws were resized, geometry memoized before no longer applies
+void CHyprNstackLayout::touchWorkspaceNodes(const int& ws) {
+    if (const auto IT = m_mWorkspaceNodes.find(ws); IT != m_mWorkspaceNodes.end())
+        IT->second.generation = ++m_iNodeGeneration;
+}
+
+// swaps the windows held by two nodes, keeping the window index in sync
+void CHyprNstackLayout::swapNodeWindows(SNstackNodeData* pNode, SNstackNodeData* pNode2) {
+    const auto PWINDOW  = pNode->pWindow.lock();
+    const auto PWINDOW2 = pNode2->pWindow.lock();
+
+    std::swap(m_mWindowNodes[PWINDOW.get()], m_mWindowNodes[PWINDOW2.get()]);
+
+    pNode->pWindow  = PWINDOW2;
+    pNode2->pWindow = PWINDOW;
+    pNode->dirty    = true;
+    pNode2->dirty   = true;
 }
 
 void CHyprNstackLayout::removeWorkspaceData(const int& ws) {
+    m_mMasterWorkspacesData.erase(ws);
+}
 
-    SNstackWorkspaceData* wsdata = nullptr;
-    for (auto& n : m_lMasterWorkspacesData) {
-        if (n.workspaceID == ws)
-            wsdata = &n;
-    }
+void CHyprNstackLayout::invalidateWorkspaceOptions() {
+    for (auto& [ws, data] : m_mMasterWorkspacesData)
+        data.optionsValid = false;
 
-    if (wsdata)
-        m_lMasterWorkspacesData.remove(*wsdata);
+    // borders, rounding etc. may have changed under the windows, reapply all of them once
+    m_cNodes.forEach([](SNstackNodeData& n) { n.dirty = true; });
 }
 
-static void applyWorkspaceLayoutOptions(SNstackWorkspaceData* wsData) {
+// plugin:nstack:layout:<name> of every option, looked up once
+static void* const* optionConfigValue(const SNstackOption& option) {
+    static const auto VALUES = [] {
+        std::array<void* const*, NSTACK_OPTION_COUNT> values{};
+        for (const auto& o : NSTACK_OPTIONS)
+            values[o.option] = HyprlandAPI::getConfigValue(PHANDLE, std::string{NSTACK_OPTION_CONFIG_PREFIX} + std::string{o.name})->getDataStaticPtr();
+        return values;
+    }();
+    return VALUES[option.option];
+}
 
-    const auto wsrule       = g_pConfigManager->getWorkspaceRuleFor(g_pCompositor->getWorkspaceByID(wsData->workspaceID));
-    const auto wslayoutopts = wsrule.layoutopts;
-
-    if (!wsData->overrides.contains("orientation")) {
-        static auto* const orientation   = (Hyprlang::STRING const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:orientation")->getDataStaticPtr();
-        std::string        wsorientation = *orientation;
-
-        if (wslayoutopts.contains("nstack-orientation"))
-            wsorientation = wslayoutopts.at("nstack-orientation");
-
-        std::string cpporientation = wsorientation;
-        //create on the fly if it doesn't exist yet
-        if (cpporientation == "top") {
-            wsData->orientation = NSTACK_ORIENTATION_TOP;
-        } else if (cpporientation == "right") {
-            wsData->orientation = NSTACK_ORIENTATION_RIGHT;
-        } else if (cpporientation == "bottom") {
-            wsData->orientation = NSTACK_ORIENTATION_BOTTOM;
-        } else if (cpporientation == "left") {
-            wsData->orientation = NSTACK_ORIENTATION_LEFT;
-        } else if (cpporientation == "vcenter") {
-            wsData->orientation = NSTACK_ORIENTATION_VCENTER;
-        } else {
-            wsData->orientation = NSTACK_ORIENTATION_HCENTER;
+// parses a rule or layoutmsg value the way the option's config value is parsed, false if it isn't one
+static bool setOptionFromString(const SNstackOption& option, SNstackOptions& options, std::string_view value) {
+    switch (option.configType()) {
+        case NSTACK_OPTION_CONFIG_STRING: nstackSetOptionString(option, options, value); return true;
+        case NSTACK_OPTION_CONFIG_INT: {
+            const auto INT = configStringToInt(std::string{value});
+            if (!INT)
+                return false;
+            nstackSetOption(option, options, *INT);
+            return true;
+        }
+        case NSTACK_OPTION_CONFIG_FLOAT: {
+            float      f         = 0;
+            const auto [PTR, EC] = std::from_chars(value.data(), value.data() + value.size(), f);
+            if (EC != std::errc{} || PTR != value.data() + value.size())
+                return false;
+            nstackSetOption(option, options, f);
+            return true;
         }
     }
+    return false;
+}
 
-    if (!wsData->overrides.contains("order")) {
-        static auto* const order   = (Hyprlang::STRING const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:order")->getDataStaticPtr();
-        std::string        wsorder = *order;
+static void applyWorkspaceLayoutOptions(SNstackWorkspaceData* wsData) {
+    for (const auto& option : NSTACK_OPTIONS) {
+        if (wsData->overrides & nstackOptionBit(option.option))
+            continue;
 
-        if (wslayoutopts.contains("nstack-order"))
-            wsorder = wslayoutopts.at("nstack-order");
-        std::string cpporder = wsorder;
-        if (cpporder.starts_with("rr")) {
-            wsData->order = NSTACK_ORDER_RROW;
-        } else if (cpporder.starts_with("rc")) {
-            wsData->order = NSTACK_ORDER_RCOLUMN;
-        } else if (cpporder.starts_with("c")) {
-            wsData->order = NSTACK_ORDER_COLUMN;
-        } else {
-            wsData->order = NSTACK_ORDER_ROW;
+        const auto VALUE = optionConfigValue(option);
+        switch (option.configType()) {
+            case NSTACK_OPTION_CONFIG_INT: nstackSetOption(option, *wsData, **(Hyprlang::INT* const*)VALUE); break;
+            case NSTACK_OPTION_CONFIG_FLOAT: nstackSetOption(option, *wsData, **(Hyprlang::FLOAT* const*)VALUE); break;
+            case NSTACK_OPTION_CONFIG_STRING: nstackSetOptionString(option, *wsData, *(Hyprlang::STRING const*)VALUE); break;
         }
     }
 
-    if (!wsData->overrides.contains("stacks")) {
-        static auto* const NUMSTACKS = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:stacks")->getDataStaticPtr();
-        auto               wsstacks  = **NUMSTACKS;
+    // nstack-<name> layoutopts on top. An invalid value keeps the config value
+    for (const auto& [key, value] : wsData->rule.layoutopts) {
+        if (!key.starts_with(NSTACK_OPTION_RULE_PREFIX))
+            continue;
+
+        const auto OPTION = nstackFindOption(std::string_view{key}.substr(NSTACK_OPTION_RULE_PREFIX.size()));
+        if (!OPTION || (wsData->overrides & nstackOptionBit(OPTION->option)))
+            continue;
 
-        if (wslayoutopts.contains("nstack-stacks")) {
-            try {
-                std::string stackstr = wslayoutopts.at("nstack-stacks");
-                wsstacks             = std::stol(stackstr);
-            } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutopt invalid rule value for nstack-stacks: {}", e.what()); }
-        }
-        if (wsstacks) {
-            wsData->m_iStackCount = wsstacks;
-        }
+        if (!setOptionFromString(*OPTION, *wsData, value))
+            Debug::log(ERR, "Nstack layoutopt invalid rule value for {}: {}", key, value);
     }
+}
 
-    if (!wsData->overrides.contains("mfact")) {
-        static auto* const MFACT   = (Hyprlang::FLOAT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:mfact")->getDataStaticPtr();
-        auto               wsmfact = **MFACT;
-        if (wslayoutopts.contains("nstack-mfact")) {
-            std::string mfactstr = wslayoutopts.at("nstack-mfact");
-            try {
-                wsmfact = std::stof(mfactstr);
-            } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutopt nstack-mfact format error: {}", e.what()); }
-        }
-        wsData->master_factor = wsmfact;
-    }
-
-    static auto* const SMFACT   = (Hyprlang::FLOAT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:single_mfact")->getDataStaticPtr();
-    auto               wssmfact = **SMFACT;
-
-    if (wslayoutopts.contains("nstack-single_mfact")) {
-        std::string smfactstr = wslayoutopts.at("nstack-single_mfact");
-        try {
-            wssmfact = std::stof(smfactstr);
-        } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutopt nstack-single_mfact format error: {}", e.what()); }
-    }
-    wsData->single_master_factor = wssmfact;
-
-    static auto* const XFACT   = (Hyprlang::FLOAT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:xfact")->getDataStaticPtr();
-    auto               wsxfact = **XFACT;
-
-    if (wslayoutopts.contains("nstack-xfact")) {
-        std::string xfactstr = wslayoutopts.at("nstack-xfact");
-        try {
-            wsxfact = std::stof(xfactstr);
-        } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutopt nstack-xfact format error: {}", e.what()); }
-    }
-    wsData->x_factor = wsxfact;
-
-    static auto* const SSFACT   = (Hyprlang::FLOAT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:special_scale_factor")->getDataStaticPtr();
-    auto               wsssfact = **SSFACT;
-    if (wslayoutopts.contains("nstack-special_scale_factor")) {
-        std::string ssfactstr = wslayoutopts.at("nstack-special_scale_factor");
-        try {
-            wsssfact = std::stof(ssfactstr);
-        } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutopt nstack-special_scale_factor format error: {}", e.what()); }
-    }
-    wsData->special_scale_factor = wsssfact;
-
-    static auto* const NEWTOP   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:new_on_top")->getDataStaticPtr();
-    auto               wsnewtop = **NEWTOP;
-    if (wslayoutopts.contains("nstack-new_on_top"))
-        wsnewtop = configStringToInt(wslayoutopts.at("nstack-new_on_top")).value_or(0);
-    wsData->new_on_top = wsnewtop;
-
-    static auto* const NEWMASTER   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:new_is_master")->getDataStaticPtr();
-    auto               wsnewmaster = **NEWMASTER;
-    if (wslayoutopts.contains("nstack-new_is_master"))
-        wsnewmaster = configStringToInt(wslayoutopts.at("nstack-new_is_master")).value_or(0);
-    wsData->new_is_master = wsnewmaster;
-
-    static auto* const NGWO   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:no_gaps_when_only")->getDataStaticPtr();
-    auto               wsngwo = **NGWO;
-    if (wslayoutopts.contains("nstack-no_gaps_when_only"))
-        wsngwo = configStringToInt(wslayoutopts.at("nstack-no_gaps_when_only")).value_or(0);
-    wsData->no_gaps_when_only = wsngwo;
-
-    static auto* const INHERITFS   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:inherit_fullscreen")->getDataStaticPtr();
-    auto               wsinheritfs = **INHERITFS;
-    if (wslayoutopts.contains("nstack-inherit_fullscreen"))
-        wsinheritfs = configStringToInt(wslayoutopts.at("nstack-inherit_fullscreen")).value_or(0);
-    wsData->inherit_fullscreen = wsinheritfs;
-
-    static auto* const CENTERSM   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:center_single_master")->getDataStaticPtr();
-    auto               wscentersm = **CENTERSM;
-    if (wslayoutopts.contains("nstack-center_single_master"))
-        wscentersm = configStringToInt(wslayoutopts.at("nstack-center_single_master")).value_or(0);
-    wsData->center_single_master = wscentersm;
-
-    static auto* const PROMOTE   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:auto_promote")->getDataStaticPtr();
-    auto               wspromote = **PROMOTE;
-    if (wslayoutopts.contains("nstack-auto_promote"))
-        wspromote = configStringToInt(wslayoutopts.at("nstack-auto_promote")).value_or(0);
-    wsData->auto_promote = wspromote;
-
-    static auto* const DEMOTE   = (Hyprlang::INT* const*)HyprlandAPI::getConfigValue(PHANDLE, "plugin:nstack:layout:auto_demote")->getDataStaticPtr();
-    auto               wsdemote = **DEMOTE;
-    if (wslayoutopts.contains("nstack-auto_demote"))
-        wsdemote = configStringToInt(wslayoutopts.at("nstack-auto_demote")).value_or(0);
-    wsData->auto_demote = wsdemote;
+static bool sameGaps(const std::optional<CCssGapData>& a, const std::optional<CCssGapData>& b) {
+    if (a.has_value() != b.has_value())
+        return false;
+    return !a || (a->m_top == b->m_top && a->m_right == b->m_right && a->m_bottom == b->m_bottom && a->m_left == b->m_left);
 }
 
 SNstackWorkspaceData* CHyprNstackLayout::getMasterWorkspaceData(const int& ws) {
-    SNstackWorkspaceData* retData = nullptr;
-    for (auto& n : m_lMasterWorkspacesData) {
-        if (n.workspaceID == ws) {
-            retData = &n;
-            break;
-        }
-    }
-    const auto PWORKSPACE   = g_pCompositor->getWorkspaceByID(ws);
-    const auto wsrule       = g_pConfigManager->getWorkspaceRuleFor(PWORKSPACE);
-    const auto wslayoutopts = wsrule.layoutopts;
+    const auto [IT, CREATED] = m_mMasterWorkspacesData.try_emplace(ws);
+    const auto retData       = &IT->second;
 
-    if (retData == nullptr) {
-        retData              = &m_lMasterWorkspacesData.emplace_back();
+    const auto PWORKSPACE = g_pCompositor->getWorkspaceByID(ws);
+
+    if (CREATED) {
         retData->workspaceID = ws;
+        restoreWorkspaceSnapshot(retData, PWORKSPACE);
+    }
+
+    // rule matching is expensive, only redo it when something a rule can depend on changed
+    SNstackRuleKey key;
+    key.tiled = getNodesOnWorkspace(ws);
+    if (PWORKSPACE) {
+        key.windows        = PWORKSPACE->getWindows();
+        key.visible        = PWORKSPACE->getWindows(std::nullopt, std::nullopt, true);
+        key.groups         = PWORKSPACE->getGroups();
+        key.fullscreenMode = PWORKSPACE->m_hasFullscreenWindow ? (int)PWORKSPACE->m_fullscreenMode : 0;
+        key.name           = PWORKSPACE->m_name;
+    }
+
+    if (!retData->optionsValid || retData->optionsKey != key) {
+        const auto OLDRULE = retData->rule;
+        const auto OLDNGWO = retData->no_gaps_when_only;
+        const auto OLDSSF  = retData->special_scale_factor;
+
+        {
+            CNstackStatTimer timer(NSTACK_STAT_RULE_LOOKUP);
+            retData->rule = g_pConfigManager->getWorkspaceRuleFor(PWORKSPACE);
+        }
+        retData->optionsValid = true;
+        retData->optionsKey   = std::move(key);
+        applyWorkspaceLayoutOptions(retData);
+
+        // gaps and decorations are applied per window and don't show up in the node boxes
+        if (!sameGaps(OLDRULE.gapsIn, retData->rule.gapsIn) || !sameGaps(OLDRULE.gapsOut, retData->rule.gapsOut) || OLDRULE.noBorder != retData->rule.noBorder ||
+            OLDRULE.decorate != retData->rule.decorate || OLDNGWO != retData->no_gaps_when_only || OLDSSF != retData->special_scale_factor)
+            retData->fullRelayout = true;
     }
-    applyWorkspaceLayoutOptions(retData);
+
     return retData;
 }
 
@@ -222,19 +256,19 @@ std::string CHyprNstackLayout::getLayoutName() {
 }
 
 SNstackNodeData* CHyprNstackLayout::getMasterNodeOnWorkspace(const int& ws) {
-    for (auto& n : m_lMasterNodesData) {
-        if (n.isMaster && n.workspaceID == ws)
-            return &n;
+    if (!getMastersOnWorkspace(ws))
+        return nullptr;
+
+    for (const auto& n : getWorkspaceNodes(ws)) {
+        if (n->isMaster)
+            return n;
     }
 
     return nullptr;
 }
 
 void CHyprNstackLayout::resetNodeSplits(const int& ws) {
-
     removeWorkspaceData(ws);
-    const auto PMONITOR = g_pCompositor->getWorkspaceByID(ws)->m_monitor.lock();
-    recalculateMonitor(PMONITOR->m_id);
 }
 
 void CHyprNstackLayout::onWindowCreatedTiling(PHLWINDOW pWindow, eDirection direction) {
@@ -247,15 +281,24 @@ void CHyprNstackLayout::onWindowCreatedTiling(PHLWINDOW pWindow, eDirection dire
 
     const auto PMONITOR = pWindow->m_monitor.lock();
 
-    const auto PNODE = WORKSPACEDATA->new_on_top ? &m_lMasterNodesData.emplace_front() : &m_lMasterNodesData.emplace_back();
-
-    PNODE->workspaceID = pWindow->workspaceID();
-    PNODE->pWindow     = pWindow;
+    const auto PNODE = addNode(pWindow, WSID, WORKSPACEDATA->new_on_top);
 
     auto       OPENINGON = isWindowTiled(g_pCompositor->m_lastWindow.lock()) && g_pCompositor->m_lastWindow.lock()->m_workspace == pWindow->m_workspace ?
               getNodeFromWindow(g_pCompositor->m_lastWindow.lock()) :
               getMasterNodeOnWorkspace(pWindow->workspaceID());
 
+    if (m_cRecorder.active()) {
+        recordWorkspace(pWindow->m_workspace, PMONITOR);
+
+        SNstackRecordEvent event;
+        event.type      = NSTACK_RECORD_WINDOW_CREATED;
+        event.window    = m_cRecorder.windowID(pWindow.get());
+        event.workspace = WSID;
+        event.arg       = direction;
+        event.arg2      = (pWindow->m_firstMap ? NSTACK_RECORD_CREATE_FIRST_MAP : 0) | (OPENINGON && OPENINGON->isMaster ? NSTACK_RECORD_CREATE_OPENING_ON_MASTER : 0);
+        m_cRecorder.record(event);
+    }
+
     const auto MOUSECOORDS = g_pInputManager->getMouseCoordsInternal();
 
     const auto WINDOWSONWORKSPACE = getNodesOnWorkspace(PNODE->workspaceID);
@@ -271,17 +314,38 @@ void CHyprNstackLayout::onWindowCreatedTiling(PHLWINDOW pWindow, eDirection dire
     bool newWindowIsPromoted = WORKSPACEDATA->auto_promote > 1 && WINDOWSONWORKSPACE == WORKSPACEDATA->auto_promote;
     if (WORKSPACEDATA->new_is_master || WINDOWSONWORKSPACE == 1 || (!pWindow->m_firstMap && OPENINGON->isMaster))
         newWindowIsMaster = true;
-    if (newWindowIsMaster || newWindowIsPromoted) {
-        for (auto& nd : m_lMasterNodesData) {
-            if (nd.isMaster && nd.workspaceID == PNODE->workspaceID) {
-                nd.isMaster        = newWindowIsPromoted;
-                lastSplitPercent   = nd.percMaster;
-                lastMasterAdjusted = nd.masterAdjusted;
+
+    // windows known from the last session go back to where they were. Only when they first show up,
+    // a window moved to another workspace or tiled again after floating keeps the place it gets now
+    const auto SNAPSHOT = pWindow->m_firstMap || m_bAdopting ? takeWindowSnapshot(pWindow) : std::nullopt;
+    if (SNAPSHOT) {
+        restoreNodeSnapshot(PNODE, *SNAPSHOT);
+
+        // the restored place has to fit it as well
+        const auto  PMASTER = getMasterNodeOnWorkspace(PNODE->workspaceID);
+        const float SPLIT   = PMASTER ? PMASTER->percMaster : 0.5f;
+        const auto  MAXSIZE = pWindow->requestedMaxSize();
+        const bool  TOOBIG  = PNODE->isMaster ? MAXSIZE.x < PMONITOR->m_size.x * SPLIT || MAXSIZE.y < PMONITOR->m_size.y :
+                                                MAXSIZE.x < PMONITOR->m_size.x * (1 - SPLIT) || MAXSIZE.y < PMONITOR->m_size.y * (1.f / (WINDOWSONWORKSPACE - 1));
+        if (TOOBIG) {
+            // we can't continue. make it floating.
+            pWindow->m_isFloating = true;
+            removeNode(pWindow);
+            recordWindowRemoved(pWindow);
+            g_pLayoutManager->getCurrentLayout()->onWindowCreatedFloating(pWindow);
+            return;
+        }
+    } else if (newWindowIsMaster || newWindowIsPromoted) {
+        for (const auto& nd : getWorkspaceNodes(PNODE->workspaceID)) {
+            if (nd->isMaster) {
+                setNodeMaster(nd, newWindowIsPromoted);
+                lastSplitPercent   = nd->percMaster;
+                lastMasterAdjusted = nd->masterAdjusted;
                 break;
             }
         }
 
-        PNODE->isMaster       = true;
+        setNodeMaster(PNODE, true);
         PNODE->percMaster     = lastSplitPercent;
         PNODE->masterAdjusted = lastMasterAdjusted;
 
@@ -289,33 +353,39 @@ void CHyprNstackLayout::onWindowCreatedTiling(PHLWINDOW pWindow, eDirection dire
         if (const auto MAXSIZE = pWindow->requestedMaxSize(); MAXSIZE.x < PMONITOR->m_size.x * lastSplitPercent || MAXSIZE.y < PMONITOR->m_size.y) {
             // we can't continue. make it floating.
             pWindow->m_isFloating = true;
-            m_lMasterNodesData.remove(*PNODE);
+            removeNode(pWindow);
+            recordWindowRemoved(pWindow);
             g_pLayoutManager->getCurrentLayout()->onWindowCreatedFloating(pWindow);
             return;
         }
     } else {
-        PNODE->isMaster = false;
+        setNodeMaster(PNODE, false);
 
         // first, check if it isn't too big.
         if (const auto MAXSIZE = pWindow->requestedMaxSize();
             MAXSIZE.x < PMONITOR->m_size.x * (1 - lastSplitPercent) || MAXSIZE.y < PMONITOR->m_size.y * (1.f / (WINDOWSONWORKSPACE - 1))) {
             // we can't continue. make it floating.
             pWindow->m_isFloating = true;
-            m_lMasterNodesData.remove(*PNODE);
+            removeNode(pWindow);
+            recordWindowRemoved(pWindow);
             g_pLayoutManager->getCurrentLayout()->onWindowCreatedFloating(pWindow);
             return;
         }
     }
 
+    // onEnable lays everything out in one go once all windows are in
+    if (m_bAdopting)
+        return;
+
     // recalc
-    recalculateMonitor(pWindow->monitorID());
+    relayoutMonitor(pWindow->monitorID());
 }
 
 void CHyprNstackLayout::onWindowRemovedTiling(PHLWINDOW pWindow) {
     if (!validMapped(pWindow))
         return;
 
-    const auto PNODE = getNodeFromWindow(pWindow);
+    auto PNODE = getNodeFromWindow(pWindow);
 
     const auto WSID = pWindow->workspaceID();
 
@@ -324,362 +394,668 @@ void CHyprNstackLayout::onWindowRemovedTiling(PHLWINDOW pWindow) {
     if (!PNODE)
         return;
 
+    recordWindowRemoved(pWindow);
+
     pWindow->unsetWindowData(PRIORITY_LAYOUT);
     pWindow->updateWindowData();
 
-    if (pWindow->isFullscreen())
+    if (pWindow->isFullscreen()) {
+        // leaving fullscreen lays the workspace out again, only the handle is safe across it
+        const auto HANDLE = PNODE->handle;
         g_pCompositor->setWindowFullscreenInternal(pWindow, FSMODE_NONE);
+        PNODE = m_cNodes.get(HANDLE);
+        if (!PNODE)
+            return;
+    }
 
     const auto MASTERSLEFT = getMastersOnWorkspace(PNODE->workspaceID);
 
     if (PNODE->isMaster && MASTERSLEFT < 2) {
         // find new one
-        for (auto& nd : m_lMasterNodesData) {
-            if (!nd.isMaster && nd.workspaceID == PNODE->workspaceID) {
-                nd.isMaster       = true;
-                nd.percMaster     = PNODE->percMaster;
-                nd.masterAdjusted = PNODE->masterAdjusted;
+        for (const auto& nd : getWorkspaceNodes(PNODE->workspaceID)) {
+            if (!nd->isMaster) {
+                setNodeMaster(nd, true);
+                nd->percMaster     = PNODE->percMaster;
+                nd->masterAdjusted = PNODE->masterAdjusted;
                 break;
             }
         }
     }
 
     const auto WORKSPACEID = PNODE->workspaceID;
+    const auto WASMASTER   = PNODE->isMaster;
 
-    m_lMasterNodesData.remove(*PNODE);
+    removeNode(pWindow);
 
-    const auto WINDOWSONWORKSPACE = getNodesOnWorkspace(PNODE->workspaceID);
+    const auto WINDOWSONWORKSPACE = getNodesOnWorkspace(WORKSPACEID);
 
-    if (!PNODE->isMaster && (getMastersOnWorkspace(WORKSPACEID) == getNodesOnWorkspace(WORKSPACEID) || WINDOWSONWORKSPACE < WORKSPACEDATA->auto_demote) && MASTERSLEFT > 1) {
-        for (auto it = m_lMasterNodesData.rbegin(); it != m_lMasterNodesData.rend(); it++) {
-            if (it->workspaceID == WORKSPACEID) {
-                it->isMaster = false;
-                break;
-            }
-        }
+    if (!WASMASTER && (getMastersOnWorkspace(WORKSPACEID) == WINDOWSONWORKSPACE || WINDOWSONWORKSPACE < WORKSPACEDATA->auto_demote) && MASTERSLEFT > 1) {
+        const auto& WSNODES = getWorkspaceHandles(WORKSPACEID);
+        if (const auto PLAST = WSNODES.empty() ? nullptr : getNode(WSNODES.back()); PLAST)
+            setNodeMaster(PLAST, false);
     }
 
-    recalculateMonitor(pWindow->monitorID());
+    // deferred, a move to another workspace is followed by a create that lays out again
+    scheduleRelayout(pWindow->monitorID());
 }
 
+// called from outside (and for option changes), every window gets reapplied
 void CHyprNstackLayout::recalculateMonitor(const MONITORID& monid) {
     const auto PMONITOR = g_pCompositor->getMonitorFromID(monid);
     if (!PMONITOR || !PMONITOR->m_activeWorkspace)
         return;
 
+    if (m_cRecorder.active())
+        recordMonitor(PMONITOR);
+
+    for (const auto& ws : {PMONITOR->m_activeSpecialWorkspace, PMONITOR->m_activeWorkspace}) {
+        if (!ws)
+            continue;
+
+        // leaving fullscreen only needs what moved, see SNstackWorkspaceData::fullscreenExited
+        const auto PWORKSPACEDATA = getMasterWorkspaceData(ws->m_id);
+        if (!PWORKSPACEDATA->fullscreenExited)
+            PWORKSPACEDATA->fullRelayout = true;
+    }
+
+    relayoutMonitor(monid);
+}
+
+// like recalculateMonitor, but run once from the event loop no matter how often it's asked for
+void CHyprNstackLayout::scheduleRecalculateMonitor(const MONITORID& monid) {
+    const auto PMONITOR = g_pCompositor->getMonitorFromID(monid);
+    if (!PMONITOR || !PMONITOR->m_activeWorkspace)
+        return;
+
+    if (PMONITOR->m_activeSpecialWorkspace)
+        getMasterWorkspaceData(PMONITOR->m_activeSpecialWorkspace->m_id)->fullRelayout = true;
+    getMasterWorkspaceData(PMONITOR->m_activeWorkspace->m_id)->fullRelayout = true;
+
+    scheduleRelayout(monid);
+}
+
+void CHyprNstackLayout::scheduleRelayout(const MONITORID& monid) {
+    m_sRelayoutStats.requested++;
+
+    if (!m_sPendingRelayouts.insert(monid).second) {
+        m_sRelayoutStats.merged++;
+        return;
+    }
+
+    if (!m_pRelayoutIdle)
+        m_pRelayoutIdle = wl_event_loop_add_idle(g_pCompositor->m_wlEventLoop, &CHyprNstackLayout::onRelayoutIdle, this);
+}
+
+void CHyprNstackLayout::onRelayoutIdle(void* data) {
+    const auto LAYOUT = (CHyprNstackLayout*)data;
+
+    // idle sources are one-shot, wayland removes it after this returns
+    LAYOUT->m_pRelayoutIdle = nullptr;
+    LAYOUT->flushPendingRelayouts();
+    LAYOUT->precomputeHiddenWorkspaces();
+}
+
+// idle time: lays out hidden workspaces whose nodes went stale, so showing one only applies its boxes.
+// Nothing is applied or damaged here, the nodes that moved stay dirty until then
+void CHyprNstackLayout::precomputeHiddenWorkspaces() {
+    std::vector<int> workspaces;
+    workspaces.reserve(m_mWorkspaceNodes.size());
+    for (const auto& [id, wsNodes] : m_mWorkspaceNodes)
+        workspaces.push_back(id);
+
+    for (const auto& id : workspaces) {
+        const auto PWORKSPACE = g_pCompositor->getWorkspaceByID(id);
+        if (!PWORKSPACE || PWORKSPACE->m_hasFullscreenWindow)
+            continue;
+
+        const auto PMONITOR = PWORKSPACE->m_monitor.lock();
+        if (!PMONITOR || PMONITOR->m_activeWorkspace == PWORKSPACE || PMONITOR->m_activeSpecialWorkspace == PWORKSPACE)
+            continue;
+
+        SNstackGeometry geom;
+        fillGeometryFrame(PWORKSPACE, PMONITOR, geom);
+        if (geometryMemoMatches(PWORKSPACE, geom))
+            continue;
+
+        fillGeometryNodes(PWORKSPACE, geom);
+        const bool LAIDOUT = m_cShapeCache.compute(geom);
+        if (storeWorkspaceGeometry(PWORKSPACE, geom, LAIDOUT, false))
+            m_sMemoStats.precomputed++;
+    }
+}
+
+void CHyprNstackLayout::flushPendingRelayouts() {
+    if (m_pRelayoutIdle) {
+        wl_event_source_remove(m_pRelayoutIdle);
+        m_pRelayoutIdle = nullptr;
+    }
+
+    if (m_sPendingRelayouts.empty())
+        return;
+
+    const std::vector<MONITORID> PENDING(m_sPendingRelayouts.begin(), m_sPendingRelayouts.end());
+    m_sPendingRelayouts.clear();
+
+    m_sRelayoutStats.flushed += PENDING.size();
+    relayoutMonitors(PENDING);
+
+    Debug::log(TRACE, "nstack: flushed {} relayouts (total: {} requested, {} merged, {} skipped, {} run)", PENDING.size(), m_sRelayoutStats.requested, m_sRelayoutStats.merged,
+               m_sRelayoutStats.skipped, m_sRelayoutStats.flushed);
+}
+
+// several monitors at once (config reloads, enabling the layout), one after another. Computing a
+// workspace is around 10-20ns per window (make bench), far below what handing the workspaces to
+// worker threads costs, so this stays on the main thread
+void CHyprNstackLayout::relayoutMonitors(const std::vector<MONITORID>& monitors) {
+    for (const auto& m : monitors)
+        relayoutMonitor(m);
+}
+
+// incremental: only nodes that moved or were marked dirty get reapplied
+void CHyprNstackLayout::relayoutMonitor(const MONITORID& monid) {
+    CNstackTraceSpan span(NSTACK_TRACE_RECALCULATE_MONITOR, monid);
+
+    // anything still pending for this monitor is covered by this pass
+    if (m_sPendingRelayouts.erase(monid))
+        m_sRelayoutStats.skipped++;
+
+    const auto PMONITOR = g_pCompositor->getMonitorFromID(monid);
+    if (!PMONITOR || !PMONITOR->m_activeWorkspace)
+        return;
+
     const auto PWORKSPACE = PMONITOR->m_activeWorkspace;
 
     if (!PWORKSPACE)
         return;
 
-    g_pHyprRenderer->damageMonitor(PMONITOR);
-
     if (PMONITOR->m_activeSpecialWorkspace) {
         calculateWorkspace(PMONITOR->m_activeSpecialWorkspace);
     }
     calculateWorkspace(PWORKSPACE);
 }
 
+static SNstackVec toNstackVec(const Vector2D& vec) {
+    return SNstackVec(vec.x, vec.y);
+}
+
+static Vector2D toVector2D(const SNstackVec& vec) {
+    return Vector2D(vec.x, vec.y);
+}
+
+// damages the boxes a node moved out of and into
+static void damageNodeMove(const CBox& from, const CBox& to) {
+    if (!from.empty())
+        g_pHyprRenderer->damageBox(from);
+    if (!to.empty())
+        g_pHyprRenderer->damageBox(to);
+}
+
+static SNstackGeometryOptions geometryOptions(const SNstackWorkspaceData* wsData) {
+    SNstackGeometryOptions options;
+    options.stackCount           = wsData->m_iStackCount;
+    options.center_single_master = wsData->center_single_master;
+    options.master_factor        = wsData->master_factor;
+    options.single_master_factor = wsData->single_master_factor;
+    options.x_factor             = wsData->x_factor;
+    options.orientation          = wsData->orientation;
+    options.order                = wsData->order;
+    return options;
+}
+
+// starts with the current state: monitors, workspace options and every node in layout order
+void CHyprNstackLayout::startRecording(const std::string& path) {
+    if (!m_cRecorder.start(path)) {
+        Debug::log(ERR, "Nstack layoutmsg record: can't write {}", path);
+        return;
+    }
+
+    for (const auto& m : g_pCompositor->m_monitors)
+        recordMonitor(m);
+
+    for (const auto& [id, wsNodes] : m_mWorkspaceNodes) {
+        if (const auto PWORKSPACE = g_pCompositor->getWorkspaceByID(id); PWORKSPACE)
+            recordWorkspace(PWORKSPACE, PWORKSPACE->m_monitor.lock());
+
+        for (const auto& n : getWorkspaceNodes(id)) {
+            SNstackRecordEvent event;
+            event.type                = NSTACK_RECORD_ADOPT;
+            event.window              = m_cRecorder.windowID(n->pWindow.lock().get());
+            event.workspace           = id;
+            event.node.isMaster       = n->isMaster;
+            event.node.masterAdjusted = n->masterAdjusted;
+            event.node.percMaster     = n->percMaster;
+            event.node.percSize       = n->percSize;
+            m_cRecorder.record(event);
+        }
+    }
+
+    Debug::log(LOG, "nstack: recording layout events to {}", path);
+}
+
+void CHyprNstackLayout::recordMonitor(PHLMONITOR PMONITOR) {
+    SNstackRecordMonitor monitor;
+    monitor.id                     = PMONITOR->m_id;
+    monitor.position               = toNstackVec(PMONITOR->m_position);
+    monitor.size                   = toNstackVec(PMONITOR->m_size);
+    monitor.reservedTopLeft        = toNstackVec(PMONITOR->m_reservedTopLeft);
+    monitor.reservedBottomRight    = toNstackVec(PMONITOR->m_reservedBottomRight);
+    monitor.activeWorkspace        = PMONITOR->m_activeWorkspace ? PMONITOR->m_activeWorkspace->m_id : -1;
+    monitor.activeSpecialWorkspace = PMONITOR->m_activeSpecialWorkspace ? PMONITOR->m_activeSpecialWorkspace->m_id : -1;
+    m_cRecorder.recordMonitor(monitor);
+}
+
+void CHyprNstackLayout::recordWorkspace(PHLWORKSPACE PWORKSPACE, PHLMONITOR PMONITOR) {
+    if (!PWORKSPACE)
+        return;
+
+    const auto             PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+    SNstackRecordWorkspace workspace;
+    workspace.id          = PWORKSPACE->m_id;
+    workspace.monitor     = PMONITOR ? PMONITOR->m_id : -1;
+    workspace.options     = geometryOptions(PWORKSPACEDATA);
+    workspace.newOnTop    = PWORKSPACEDATA->new_on_top;
+    workspace.newIsMaster = PWORKSPACEDATA->new_is_master;
+    workspace.autoPromote = PWORKSPACEDATA->auto_promote;
+    workspace.autoDemote  = PWORKSPACEDATA->auto_demote;
+    m_cRecorder.recordWorkspace(workspace);
+}
+
+void CHyprNstackLayout::recordWindowRemoved(PHLWINDOW pWindow) {
+    if (!m_cRecorder.active())
+        return;
+
+    SNstackRecordEvent event;
+    event.type   = NSTACK_RECORD_WINDOW_REMOVED;
+    event.window = m_cRecorder.windowID(pWindow.get());
+    m_cRecorder.record(event);
+    m_cRecorder.forgetWindow(pWindow.get());
+}
+
 void CHyprNstackLayout::calculateWorkspace(PHLWORKSPACE PWORKSPACE) {
     if (!PWORKSPACE)
         return;
 
-    const auto PMONITOR = PWORKSPACE->m_monitor.lock();
+    CNstackStatTimer timer(NSTACK_STAT_CALCULATE_WORKSPACE);
+    CNstackTraceSpan span(NSTACK_TRACE_CALCULATE_WORKSPACE, PWORKSPACE->m_id);
 
-    if (!PMONITOR)
+    SNstackGeometry  geom;
+    if (!prepareWorkspaceGeometry(PWORKSPACE, geom))
         return;
 
-    const auto      PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
-    auto            NUMSTACKS      = PWORKSPACEDATA->m_iStackCount;
+    const bool LAIDOUT = m_cShapeCache.compute(geom);
 
-    const auto      PMASTERNODE = getMasterNodeOnWorkspace(PWORKSPACE->m_id);
-    const auto      NODECOUNT   = getNodesOnWorkspace(PWORKSPACE->m_id);
+    applyWorkspaceGeometry(PWORKSPACE, geom, LAIDOUT);
+}
 
-    eColOrientation orientation = PWORKSPACEDATA->orientation;
-    eColOrder       order       = PWORKSPACEDATA->order;
+// main thread: snapshots everything the geometry depends on into geom.
+// Returns false if there's nothing to compute (fullscreen workspaces are handled right here)
+bool CHyprNstackLayout::prepareWorkspaceGeometry(PHLWORKSPACE PWORKSPACE, SNstackGeometry& geom) {
+    const auto PMONITOR = PWORKSPACE->m_monitor.lock();
 
-    auto            MCONTAINERPOS  = Vector2D(0.0f, 0.0f);
-    auto            MCONTAINERSIZE = Vector2D(0.0f, 0.0f);
-    auto            MARGIN         = Vector2D(0.0f, 0.0f);
-    auto            TOPLEFT        = PMONITOR->m_reservedTopLeft;
-    auto            BOTTOMRIGHT    = PMONITOR->m_reservedBottomRight;
-    if (PWORKSPACEDATA->x_factor > 0.0f && PWORKSPACEDATA->x_factor < 1.0f) {
-        MARGIN = Vector2D(orientation % 2 == 0 ? (1.0f - PWORKSPACEDATA->x_factor) * PMONITOR->m_size.x / 2.f : 0.0f,
-                          orientation % 2 == 1 ? (1.0f - PWORKSPACEDATA->x_factor) * PMONITOR->m_size.y / 2.f : 0.0f);
-        TOPLEFT += MARGIN;
-        BOTTOMRIGHT += MARGIN;
-    }
+    if (!PMONITOR)
+        return false;
 
+    const auto PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+
+    fillGeometryFrame(PWORKSPACE, PMONITOR, geom);
+
+    // the tiles are hidden: nothing is computed or applied for them until the fullscreen window goes
+    // away, only that window is kept on its box. Their nodes catch up in one pass on exit
     if (PWORKSPACE->m_hasFullscreenWindow) {
-        // massive hack from the fullscreen func
+        m_sRelayoutStats.suspended++;
+
         const auto PFULLWINDOW = PWORKSPACE->getFullscreenWindow();
 
         if (PWORKSPACE->m_fullscreenMode == FSMODE_FULLSCREEN) {
             *PFULLWINDOW->m_realPosition = PMONITOR->m_position;
             *PFULLWINDOW->m_realSize     = PMONITOR->m_size;
         } else if (PWORKSPACE->m_fullscreenMode == FSMODE_MAXIMIZED) {
-            for (auto& n : m_lMasterNodesData) {
-                if (n.workspaceID != PWORKSPACE->m_id)
-                    continue;
-
-                SNstackNodeData fakeNode;
-                fakeNode.pWindow                = n.pWindow;
-                fakeNode.position               = PMONITOR->m_position + TOPLEFT;
-                fakeNode.size                   = PMONITOR->m_size - TOPLEFT - BOTTOMRIGHT;
-                fakeNode.workspaceID            = PWORKSPACE->m_id;
-                PFULLWINDOW->m_position         = fakeNode.position;
-                PFULLWINDOW->m_size             = fakeNode.size;
-                fakeNode.ignoreFullscreenChecks = true;
-
-                applyNodeDataToWindow(&fakeNode);
-            }
+            SNstackVec topLeft, bottomRight;
+            nstackReservedArea(geom, topLeft, bottomRight);
+            const auto TOPLEFT     = toVector2D(topLeft);
+            const auto BOTTOMRIGHT = toVector2D(bottomRight);
+
+            // massive hack from the fullscreen func, kept across passes so unchanged applies are skipped
+            auto& fakeNode = PWORKSPACEDATA->fullscreenNode;
+            if (fakeNode.pWindow.lock() != PFULLWINDOW)
+                fakeNode = SNstackNodeData{};
+
+            fakeNode.pWindow                = PFULLWINDOW;
+            fakeNode.position               = PMONITOR->m_position + TOPLEFT;
+            fakeNode.size                   = PMONITOR->m_size - TOPLEFT - BOTTOMRIGHT;
+            fakeNode.workspaceID            = PWORKSPACE->m_id;
+            PFULLWINDOW->m_position         = fakeNode.position;
+            PFULLWINDOW->m_size             = fakeNode.size;
+            fakeNode.ignoreFullscreenChecks = true;
+
+            applyNodeDataToWindow(&fakeNode);
+            fakeNode.dirty = false;
         }
 
-        // if has fullscreen, don't calculate the rest
-        return;
+        return false;
     }
 
-    if (!PMASTERNODE)
-        return;
+    // nothing the layout depends on changed since the nodes were last laid out (e.g. switching
+    // back to a workspace, or one precomputed while hidden), their boxes only need applying
+    if (geometryMemoMatches(PWORKSPACE, geom)) {
+        m_sMemoStats.hits++;
+        applyWorkspaceWindows(PWORKSPACE);
+        return false;
+    }
+
+    m_sMemoStats.misses++;
+    fillGeometryNodes(PWORKSPACE, geom);
+
+    return true;
+}
 
-    const auto MASTERS     = getMastersOnWorkspace(PWORKSPACE->m_id);
-    const auto ONLYMASTERS = !(NODECOUNT - MASTERS);
+void CHyprNstackLayout::fillGeometryFrame(PHLWORKSPACE PWORKSPACE, PHLMONITOR PMONITOR, SNstackGeometry& geom) {
+    geom.monitorPosition     = toNstackVec(PMONITOR->m_position);
+    geom.monitorSize         = toNstackVec(PMONITOR->m_size);
+    geom.reservedTopLeft     = toNstackVec(PMONITOR->m_reservedTopLeft);
+    geom.reservedBottomRight = toNstackVec(PMONITOR->m_reservedBottomRight);
+    geom.options             = geometryOptions(getMasterWorkspaceData(PWORKSPACE->m_id));
 
-    if (NUMSTACKS < 3 && orientation > NSTACK_ORIENTATION_BOTTOM) {
-        NUMSTACKS = 3;
+    if (m_cRecorder.active()) {
+        recordMonitor(PMONITOR);
+        recordWorkspace(PWORKSPACE, PMONITOR);
     }
+}
 
-    if (!PMASTERNODE->masterAdjusted) {
-        if (getNodesOnWorkspace(PWORKSPACE->m_id) < NUMSTACKS) {
-            PMASTERNODE->percMaster = PWORKSPACEDATA->master_factor ? PWORKSPACEDATA->master_factor : 1.0f / getNodesOnWorkspace(PWORKSPACE->m_id);
-        } else {
-            PMASTERNODE->percMaster = PWORKSPACEDATA->master_factor ? PWORKSPACEDATA->master_factor : 1.0f / (NUMSTACKS);
-        }
+void CHyprNstackLayout::fillGeometryNodes(PHLWORKSPACE PWORKSPACE, SNstackGeometry& geom) {
+    const auto PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+
+    geom.nodes.reserve(getNodesOnWorkspace(PWORKSPACE->m_id));
+    for (const auto& n : getWorkspaceNodes(PWORKSPACE->m_id)) {
+        auto& gn          = geom.nodes.emplace_back();
+        gn.isMaster       = n->isMaster;
+        gn.masterAdjusted = n->masterAdjusted;
+        gn.percMaster     = n->percMaster;
+        gn.percSize       = n->percSize;
+        gn.stackNum       = n->stackNum;
+        gn.position       = toNstackVec(n->position);
+        gn.size           = toNstackVec(n->size);
     }
-    bool centerMasterWindow = false;
-    if (PWORKSPACEDATA->center_single_master)
-        centerMasterWindow = true;
-    if (!ONLYMASTERS && NODECOUNT - MASTERS < 2) {
-        if (orientation == NSTACK_ORIENTATION_HCENTER) {
-            orientation = NSTACK_ORIENTATION_LEFT;
-        } else if (orientation == NSTACK_ORIENTATION_VCENTER) {
-            orientation = NSTACK_ORIENTATION_TOP;
+    geom.stackPercs     = std::move(PWORKSPACEDATA->stackPercs);
+    geom.stackNodeCount = std::move(PWORKSPACEDATA->stackNodeCount);
+}
+
+static SNstackGeometryMemo geometryMemo(const SNstackGeometry& geom, uint64_t generation) {
+    SNstackGeometryMemo memo;
+    memo.valid               = true;
+    memo.generation          = generation;
+    memo.monitorPosition     = geom.monitorPosition;
+    memo.monitorSize         = geom.monitorSize;
+    memo.reservedTopLeft     = geom.reservedTopLeft;
+    memo.reservedBottomRight = geom.reservedBottomRight;
+    memo.options             = geom.options;
+    return memo;
+}
+
+// geom only needs its frame filled
+bool CHyprNstackLayout::geometryMemoMatches(PHLWORKSPACE PWORKSPACE, const SNstackGeometry& geom) {
+    const auto IT = m_mWorkspaceNodes.find(PWORKSPACE->m_id);
+    if (IT == m_mWorkspaceNodes.end())
+        return false;
+
+    const auto& MEMO = getMasterWorkspaceData(PWORKSPACE->m_id)->geometryMemo;
+    return MEMO.valid && MEMO == geometryMemo(geom, IT->second.generation);
+}
+
+// main thread: takes back what prepareWorkspaceGeometry handed out and writes the computed boxes
+// into the nodes. Returns false if there was nothing to lay out
+bool CHyprNstackLayout::storeWorkspaceGeometry(PHLWORKSPACE PWORKSPACE, SNstackGeometry& geom, bool laidOut, bool visible) {
+    const auto PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+
+    PWORKSPACEDATA->stackPercs     = std::move(geom.stackPercs);
+    PWORKSPACEDATA->stackNodeCount = std::move(geom.stackNodeCount);
+    PWORKSPACEDATA->geometryMemo   = {};
+
+    const auto& WSNODES = getWorkspaceHandles(PWORKSPACE->m_id);
+
+    if (!laidOut || geom.nodes.size() != WSNODES.size())
+        return false;
+
+    bool moved         = false;
+    bool stacksChanged = false;
+
+    // only what actually moved gets damaged and reapplied, the rest of the workspace is left alone
+    for (size_t i = 0; i < WSNODES.size(); ++i) {
+        const auto& gn = geom.nodes[i];
+        const auto  n  = getNode(WSNODES[i]);
+        if (!n)
+            continue;
+
+        const auto NEWPOS  = toVector2D(gn.position);
+        const auto NEWSIZE = toVector2D(gn.size);
+
+        if (NEWPOS != n->position || NEWSIZE != n->size) {
+            if (visible)
+                damageNodeMove(CBox{n->position, n->size}, CBox{NEWPOS, NEWSIZE});
+            n->dirty = true;
+            moved    = true;
+            PWORKSPACEDATA->movedNodes++;
         }
+
+        if (gn.stackNum != n->stackNum)
+            stacksChanged = true;
+
+        n->percMaster = gn.percMaster;
+        n->stackNum   = gn.stackNum;
+        n->position   = NEWPOS;
+        n->size       = NEWSIZE;
     }
 
-    if (ONLYMASTERS) {
-        if (centerMasterWindow) {
+    auto& wsNodes = m_mWorkspaceNodes[PWORKSPACE->m_id];
+    if (moved || stacksChanged)
+        wsNodes.spatialValid = false;
 
-            if (!PMASTERNODE->masterAdjusted)
-                PMASTERNODE->percMaster = PWORKSPACEDATA->single_master_factor ? PWORKSPACEDATA->single_master_factor : 0.5f;
+    // column orders take the previous stack assignment as input, their result only holds once it reproduces it
+    if (!stacksChanged || geom.options.order % 2 == 0)
+        PWORKSPACEDATA->geometryMemo = geometryMemo(geom, wsNodes.generation);
 
-            if (orientation == NSTACK_ORIENTATION_TOP || orientation == NSTACK_ORIENTATION_BOTTOM) {
-                const float HEIGHT        = (PMONITOR->m_size.y - TOPLEFT.y - BOTTOMRIGHT.y) * PMASTERNODE->percMaster;
-                float       CENTER_OFFSET = (PMONITOR->m_size.y - HEIGHT) / 2;
-                MCONTAINERSIZE            = Vector2D(PMONITOR->m_size.x - TOPLEFT.x - BOTTOMRIGHT.x, HEIGHT);
-                MCONTAINERPOS             = TOPLEFT + PMONITOR->m_position + Vector2D(0.0, CENTER_OFFSET);
-            } else {
-                const float WIDTH         = (PMONITOR->m_size.x - TOPLEFT.x - BOTTOMRIGHT.x) * PMASTERNODE->percMaster;
-                float       CENTER_OFFSET = (PMONITOR->m_size.x - WIDTH) / 2;
-                MCONTAINERSIZE            = Vector2D(WIDTH, PMONITOR->m_size.y - TOPLEFT.y - BOTTOMRIGHT.y);
-                MCONTAINERPOS             = TOPLEFT + PMONITOR->m_position + Vector2D(CENTER_OFFSET, 0.0);
-            }
-        } else {
-            MCONTAINERPOS  = TOPLEFT + PMONITOR->m_position;
-            MCONTAINERSIZE = Vector2D(PMONITOR->m_size.x - TOPLEFT.x - BOTTOMRIGHT.x, PMONITOR->m_size.y - BOTTOMRIGHT.y - TOPLEFT.y);
+    return true;
+}
+
+void CHyprNstackLayout::applyWorkspaceGeometry(PHLWORKSPACE PWORKSPACE, SNstackGeometry& geom, bool laidOut) {
+    if (storeWorkspaceGeometry(PWORKSPACE, geom, laidOut, true))
+        applyWorkspaceWindows(PWORKSPACE);
+}
+
+// applies the boxes stored in the nodes to their windows
+void CHyprNstackLayout::applyWorkspaceWindows(PHLWORKSPACE PWORKSPACE) {
+    const auto PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+
+    const bool FULL                  = PWORKSPACEDATA->fullRelayout;
+    PWORKSPACEDATA->fullRelayout     = false;
+    PWORKSPACEDATA->fullscreenExited = false;
+
+    const auto MOVED = std::exchange(PWORKSPACEDATA->movedNodes, 0);
+    if (PWORKSPACEDATA->max_animated_windows > 0 && MOVED > PWORKSPACEDATA->max_animated_windows)
+        markWarpedNodes(PWORKSPACE->m_id);
+
+    prepareWindowBoxes(PWORKSPACE, FULL);
+
+    // masters first, then the stacks
+    for (const auto& n : getWorkspaceNodes(PWORKSPACE->m_id)) {
+        if (n->isMaster && (FULL || n->dirty)) {
+            applyNodeDataToWindow(n);
+            n->dirty = false;
         }
-    } else {
-        const float MASTERSIZE = orientation % 2 == 0 ? (PMONITOR->m_size.x - TOPLEFT.x - BOTTOMRIGHT.x) * PMASTERNODE->percMaster :
-                                                        (PMONITOR->m_size.y - TOPLEFT.y - BOTTOMRIGHT.y) * PMASTERNODE->percMaster;
-
-        if (orientation == NSTACK_ORIENTATION_RIGHT) {
-            MCONTAINERPOS  = TOPLEFT + PMONITOR->m_position + Vector2D(PMONITOR->m_size.x - MASTERSIZE - BOTTOMRIGHT.x - TOPLEFT.x, 0.0f);
-            MCONTAINERSIZE = Vector2D(MASTERSIZE, PMONITOR->m_size.y - BOTTOMRIGHT.y - TOPLEFT.y);
-        } else if (orientation == NSTACK_ORIENTATION_LEFT) {
-            MCONTAINERPOS  = TOPLEFT + PMONITOR->m_position;
-            MCONTAINERSIZE = Vector2D(MASTERSIZE, PMONITOR->m_size.y - BOTTOMRIGHT.y - TOPLEFT.y);
-        } else if (orientation == NSTACK_ORIENTATION_TOP) {
-            MCONTAINERPOS  = TOPLEFT + PMONITOR->m_position;
-            MCONTAINERSIZE = Vector2D(PMONITOR->m_size.x - BOTTOMRIGHT.x - TOPLEFT.x, MASTERSIZE);
-        } else if (orientation == NSTACK_ORIENTATION_BOTTOM) {
-            MCONTAINERPOS  = TOPLEFT + PMONITOR->m_position + Vector2D(0.0f, PMONITOR->m_size.y - MASTERSIZE - BOTTOMRIGHT.y - TOPLEFT.y);
-            MCONTAINERSIZE = Vector2D(PMONITOR->m_size.x - BOTTOMRIGHT.x - TOPLEFT.x, MASTERSIZE);
-
-        } else if (orientation == NSTACK_ORIENTATION_HCENTER) {
-            float CENTER_OFFSET = (PMONITOR->m_size.x - MASTERSIZE - 2.f * MARGIN.x) / 2;
-            MCONTAINERSIZE      = Vector2D(MASTERSIZE, PMONITOR->m_size.y - TOPLEFT.y - BOTTOMRIGHT.y);
-            MCONTAINERPOS       = TOPLEFT + PMONITOR->m_position + Vector2D(CENTER_OFFSET, 0.0);
-        } else if (orientation == NSTACK_ORIENTATION_VCENTER) {
-            float CENTER_OFFSET = (PMONITOR->m_size.y - MASTERSIZE - 2.f * MARGIN.y) / 2;
-            MCONTAINERSIZE      = Vector2D(PMONITOR->m_size.x - TOPLEFT.x - BOTTOMRIGHT.x, MASTERSIZE);
-            MCONTAINERPOS       = TOPLEFT + PMONITOR->m_position + Vector2D(0.0, CENTER_OFFSET);
+    }
+
+    for (const auto& n : getWorkspaceNodes(PWORKSPACE->m_id)) {
+        if (!n->isMaster && (FULL || n->dirty)) {
+            applyNodeDataToWindow(n);
+            n->dirty = false;
         }
     }
 
-    if (MCONTAINERSIZE != Vector2D(0, 0)) {
-        float       nodeSpaceLeft = orientation % 2 == 0 ? MCONTAINERSIZE.y : MCONTAINERSIZE.x;
-        int         nodesLeft     = MASTERS;
-        float       nextNodeCoord = 0;
-        const float MASTERSIZE    = orientation % 2 == 0 ? MCONTAINERSIZE.x : MCONTAINERSIZE.y;
-        for (auto& n : m_lMasterNodesData) {
-            if (n.workspaceID == PWORKSPACE->m_id && n.isMaster) {
-                if (orientation == NSTACK_ORIENTATION_RIGHT) {
-                    n.position = MCONTAINERPOS + Vector2D(0.0f, nextNodeCoord);
-                } else if (orientation == NSTACK_ORIENTATION_LEFT) {
-
-                    n.position = MCONTAINERPOS + Vector2D(0.0, nextNodeCoord);
-                } else if (orientation == NSTACK_ORIENTATION_TOP) {
-                    n.position = MCONTAINERPOS + Vector2D(nextNodeCoord, 0.0);
-                } else if (orientation == NSTACK_ORIENTATION_BOTTOM) {
-                    n.position = MCONTAINERPOS + Vector2D(nextNodeCoord, 0.0);
-                } else if (orientation == NSTACK_ORIENTATION_HCENTER) {
-                    n.position = MCONTAINERPOS + Vector2D(0.0, nextNodeCoord);
-                } else {
-                    n.position = MCONTAINERPOS + Vector2D(nextNodeCoord, 0.0);
-                }
+    scheduleSnapshotSave();
+}
 
-                float NODESIZE = nodesLeft > 1 ? nodeSpaceLeft / nodesLeft * n.percSize : nodeSpaceLeft;
-                if (NODESIZE > nodeSpaceLeft * 0.9f && nodesLeft > 1)
-                    NODESIZE = nodeSpaceLeft * 0.9f;
+// too many windows move at once: only the focused one and the tiles touching it animate, the
+// rest are warped to their new box by applyNodeGeometry
+void CHyprNstackLayout::markWarpedNodes(const int& ws) {
+    const auto PFOCUSED = getNodeFromWindow(g_pCompositor->m_lastWindow.lock());
+    const bool ONHERE   = PFOCUSED && PFOCUSED->workspaceID == ws;
 
-                n.size = orientation % 2 == 0 ? Vector2D(MASTERSIZE, NODESIZE) : Vector2D(NODESIZE, MASTERSIZE);
-                nodesLeft--;
-                nodeSpaceLeft -= NODESIZE;
-                nextNodeCoord += NODESIZE;
-                applyNodeDataToWindow(&n);
-            }
-        }
+    // the boxes don't include gaps, so neighbouring tiles share an edge (give or take rounding)
+    const auto TOUCHES = [PFOCUSED](const SNstackNodeData* n) {
+        const CBox FOCUSED = CBox{PFOCUSED->position, PFOCUSED->size}.expand(1);
+        return FOCUSED.overlaps(CBox{n->position, n->size});
+    };
+
+    for (const auto& n : getWorkspaceNodes(ws)) {
+        if (!n->dirty || (ONHERE && TOUCHES(n)))
+            continue;
+        n->warp = true;
+        m_iWarpedWindows++;
+    }
+}
+
+void CHyprNstackLayout::applyNodeDataToWindow(SNstackNodeData* pNode) {
+    CNstackStatTimer timer(NSTACK_STAT_APPLY_NODE);
+    CNstackTraceSpan span(NSTACK_TRACE_APPLY_NODE, pNode->workspaceID);
+
+    const auto       PWINDOW = pNode->pWindow.lock();
+    if (!PWINDOW)
+        return;
+
+    const auto OLDPOS  = PWINDOW->m_realPosition->goal();
+    const auto OLDSIZE = PWINDOW->m_realSize->goal();
+
+    applyNodeGeometry(pNode);
+
+    if (OLDPOS != PWINDOW->m_realPosition->goal() || OLDSIZE != PWINDOW->m_realSize->goal()) {
+        g_nstackStats.addGeometryChanges(m_eStatOp, 1);
+        getMasterWorkspaceData(pNode->workspaceID)->geometryChanges[m_eStatOp]++;
     }
+}
+
+// gaps_in/gaps_out (workspace rule first), usable area and scale the windows of a workspace get
+SNstackGapOptions CHyprNstackLayout::gapOptions(PHLWORKSPACE PWORKSPACE, PHLMONITOR PMONITOR) {
+    const auto         PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+    const auto&        WORKSPACERULE  = PWORKSPACEDATA->rule;
+
+    static auto* const PGAPSINDATA  = (Hyprlang::CUSTOMTYPE* const*)g_pConfigManager->getConfigValuePtr("general:gaps_in");
+    static auto* const PGAPSOUTDATA = (Hyprlang::CUSTOMTYPE* const*)g_pConfigManager->getConfigValuePtr("general:gaps_out");
+    const auto         GAPSIN       = WORKSPACERULE.gapsIn.value_or(*(CCssGapData*)(*PGAPSINDATA)->getData());
+    const auto         GAPSOUT      = WORKSPACERULE.gapsOut.value_or(*(CCssGapData*)(*PGAPSOUTDATA)->getData());
+
+    SNstackGapOptions  opts;
+    opts.gapsIn          = {(double)GAPSIN.m_top, (double)GAPSIN.m_right, (double)GAPSIN.m_bottom, (double)GAPSIN.m_left};
+    opts.gapsOut         = {(double)GAPSOUT.m_top, (double)GAPSOUT.m_right, (double)GAPSOUT.m_bottom, (double)GAPSOUT.m_left};
+    opts.areaTopLeft     = toNstackVec(PMONITOR->m_position + PMONITOR->m_reservedTopLeft);
+    opts.areaBottomRight = toNstackVec(PMONITOR->m_position + PMONITOR->m_size - PMONITOR->m_reservedBottomRight);
+    opts.scale           = g_pCompositor->isWorkspaceSpecial(PWORKSPACE->m_id) ? PWORKSPACEDATA->special_scale_factor : 1.0;
+    return opts;
+}
+
+// gaps, reserved area and special scaling for every window the pass is about to apply, in one
+// go over the workspace's SNstackBoxes. applyNodeGeometry picks the results up through boxIndex
+void CHyprNstackLayout::prepareWindowBoxes(PHLWORKSPACE PWORKSPACE, bool full) {
+    const auto PMONITOR = PWORKSPACE->m_monitor.lock();
 
-    //compute placement of slave window(s)
-    int slavesLeft  = getNodesOnWorkspace(PWORKSPACE->m_id) - MASTERS;
-    int slavesTotal = slavesLeft;
-    if (slavesTotal < 1)
+    if (!PMONITOR)
         return;
-    int numStacks      = slavesTotal > NUMSTACKS - 1 ? NUMSTACKS - 1 : slavesTotal;
-    int numStackBefore = numStacks / 2 + numStacks % 2;
-    int numStackAfter  = numStacks / 2;
 
-    PWORKSPACEDATA->stackNodeCount.assign(numStacks + 1, 0);
-    PWORKSPACEDATA->stackPercs.resize(numStacks + 1, 1.0f);
+    auto&                   wsNodes = m_mWorkspaceNodes[PWORKSPACE->m_id];
+    auto&                   boxes   = wsNodes.boxes;
+    const SNstackGapOptions OPTS    = gapOptions(PWORKSPACE, PMONITOR);
 
-    float                 stackNodeSizeLeft = orientation % 2 == 1 ? PMONITOR->m_size.x - BOTTOMRIGHT.x - TOPLEFT.x : PMONITOR->m_size.y - BOTTOMRIGHT.y - TOPLEFT.y;
+    boxes.resize(wsNodes.nodes.size());
 
-    int                   stackNum = 0;
-    std::vector<float>    nodeSpaceLeft(numStacks, stackNodeSizeLeft);
-    std::vector<float>    nodeNextCoord(numStacks, 0);
-    std::vector<Vector2D> stackCoords(numStacks, Vector2D(0, 0));
+    size_t count = 0;
+    for (const auto& n : getWorkspaceNodes(PWORKSPACE->m_id)) {
+        n->boxIndex        = -1;
+        const auto PWINDOW = n->pWindow.lock();
 
-    const float           STACKSIZE = orientation % 2 == 1 ? (PMONITOR->m_size.y - BOTTOMRIGHT.y - TOPLEFT.y - PMASTERNODE->size.y) / numStacks :
-                                                             (PMONITOR->m_size.x - BOTTOMRIGHT.x - TOPLEFT.x - PMASTERNODE->size.x) / numStacks;
+        if (!(full || n->dirty) || !validMapped(PWINDOW))
+            continue;
 
-    const float           STACKSIZEBEFORE = numStackBefore ? ((STACKSIZE * numStacks) / 2) / numStackBefore : 0.0f;
-    const float           STACKSIZEAFTER  = numStackAfter ? ((STACKSIZE * numStacks) / 2) / numStackAfter : 0.0f;
+        const auto RESERVED = PWINDOW->getFullWindowReservedArea();
 
-    //Pre calculate each stack's coordinates so we can take into account manual resizing
-    if (orientation == NSTACK_ORIENTATION_LEFT || orientation == NSTACK_ORIENTATION_TOP) {
-        numStackBefore = 0;
-        numStackAfter  = numStacks;
-    } else if (orientation == NSTACK_ORIENTATION_RIGHT || orientation == NSTACK_ORIENTATION_BOTTOM) {
-        numStackAfter  = 0;
-        numStackBefore = numStacks;
+        boxes.x[count]              = n->position.x;
+        boxes.y[count]              = n->position.y;
+        boxes.w[count]              = n->size.x;
+        boxes.h[count]              = n->size.y;
+        boxes.reservedLeft[count]   = RESERVED.topLeft.x;
+        boxes.reservedTop[count]    = RESERVED.topLeft.y;
+        boxes.reservedRight[count]  = RESERVED.bottomRight.x;
+        boxes.reservedBottom[count] = RESERVED.bottomRight.y;
+        n->boxIndex                 = count++;
     }
+    boxes.count = count;
 
-    for (int i = 0; i < numStacks; i++) {
-        float useSize = STACKSIZE;
-        if (orientation > NSTACK_ORIENTATION_BOTTOM) {
-            if (i < numStackBefore)
-                useSize = STACKSIZEBEFORE;
-            else
-                useSize = STACKSIZEAFTER;
-        }
+    nstackApplyGaps(boxes, OPTS);
+}
 
-        //The Vector here isn't 'x,y', it is 'stack start, stack end'
-        double coordAdjust = 0;
-        if (i == numStackBefore && numStackAfter) {
-            coordAdjust = orientation % 2 == 1 ? PMASTERNODE->position.y + PMASTERNODE->size.y - PMONITOR->m_position.y - TOPLEFT.y :
-                                                 PMASTERNODE->position.x + PMASTERNODE->size.x - PMONITOR->m_position.x - TOPLEFT.x;
-        }
-        float monMax     = orientation % 2 == 1 ? PMONITOR->m_size.y - TOPLEFT.y - BOTTOMRIGHT.y : PMONITOR->m_size.x - TOPLEFT.x - BOTTOMRIGHT.x;
-        float stackStart = 0.0f;
-        if (i == numStackBefore && numStackAfter) {
-            stackStart = coordAdjust;
-        } else if (i) {
-            stackStart = stackCoords[i - 1].y;
-        }
-        float scaledSize = useSize * PWORKSPACEDATA->stackPercs[i + 1];
-
-        //Stacks at bottom and right always fill remaining space
-        //Stacks that end adjacent to the master stack are pinned to it
-
-        if (orientation == NSTACK_ORIENTATION_LEFT && i >= numStacks - 1) {
-            scaledSize = monMax - stackStart;
-        } else if (orientation == NSTACK_ORIENTATION_RIGHT && i >= numStacks - 1) {
-            scaledSize = (PMASTERNODE->position.x - PMONITOR->m_position.x - TOPLEFT.x) - stackStart;
-        } else if (orientation == NSTACK_ORIENTATION_TOP && i >= numStacks - 1) {
-            scaledSize = monMax - stackStart;
-        } else if (orientation == NSTACK_ORIENTATION_BOTTOM && i >= numStacks - 1) {
-            scaledSize = (PMASTERNODE->position.y - PMONITOR->m_position.y - TOPLEFT.y) - stackStart;
-        } else if (orientation == NSTACK_ORIENTATION_HCENTER) {
-            if (i >= numStacks - 1) {
-                scaledSize = monMax - stackStart;
-            } else if (i == numStacks - 2) {
-                scaledSize = (PMASTERNODE->position.x - PMONITOR->m_position.x - TOPLEFT.x) - stackStart;
-            }
-        } else if (orientation == NSTACK_ORIENTATION_VCENTER) {
-            if (i >= numStacks - 1) {
-                scaledSize = monMax - stackStart;
-            } else if (i == numStacks - 2) {
-                scaledSize = (PMASTERNODE->position.y - PMONITOR->m_position.y - TOPLEFT.y) - stackStart;
-            }
-        }
-        stackCoords[i] = Vector2D(stackStart, stackStart + scaledSize);
-    }
+// the box prepareWindowBoxes computed for a node, unless the window's reserved area changed since
+bool CHyprNstackLayout::windowBoxFromPass(SNstackNodeData* pNode, int boxIndex, const SBoxExtents& reserved, CBox& box) {
+    const auto IT = m_mWorkspaceNodes.find(pNode->workspaceID);
 
-    if (order > NSTACK_ORDER_COLUMN)
-        std::reverse(stackCoords.begin(), stackCoords.end());
+    if (boxIndex < 0 || IT == m_mWorkspaceNodes.end() || (size_t)boxIndex >= IT->second.boxes.count)
+        return false;
 
-    for (auto& nd : m_lMasterNodesData) {
-        if (nd.workspaceID != PWORKSPACE->m_id || nd.isMaster)
-            continue;
+    const auto& BOXES = IT->second.boxes;
+    if (BOXES.reservedLeft[boxIndex] != reserved.topLeft.x || BOXES.reservedTop[boxIndex] != reserved.topLeft.y || BOXES.reservedRight[boxIndex] != reserved.bottomRight.x ||
+        BOXES.reservedBottom[boxIndex] != reserved.bottomRight.y)
+        return false;
 
-        Vector2D stackPos = stackCoords[stackNum];
-        if (orientation % 2 == 0) {
-            nd.position = TOPLEFT + PMONITOR->m_position + Vector2D(stackPos.x, nodeNextCoord[stackNum]);
-        } else {
-            nd.position = TOPLEFT + PMONITOR->m_position + Vector2D(nodeNextCoord[stackNum], stackPos.x);
-        }
+    box = CBox{BOXES.x[boxIndex], BOXES.y[boxIndex], BOXES.w[boxIndex], BOXES.h[boxIndex]};
+    return true;
+}
+
+// final box of a tiled window: from the pass's SNstackBoxes if there is one, otherwise the same arithmetic as nstackApplyGaps
+CBox CHyprNstackLayout::windowBox(SNstackNodeData* pNode, PHLMONITOR PMONITOR, int boxIndex, const SBoxExtents& reserved) {
+    CBox wb;
+
+    if (!windowBoxFromPass(pNode, boxIndex, reserved, wb)) {
+        const auto         PWORKSPACEDATA = getMasterWorkspaceData(pNode->workspaceID);
+        const auto&        WORKSPACERULE  = PWORKSPACEDATA->rule;
+
+        static auto* const PGAPSINDATA  = (Hyprlang::CUSTOMTYPE* const*)g_pConfigManager->getConfigValuePtr("general:gaps_in");
+        static auto* const PGAPSOUTDATA = (Hyprlang::CUSTOMTYPE* const*)g_pConfigManager->getConfigValuePtr("general:gaps_out");
+        auto* const        PGAPSIN      = (CCssGapData*)(*PGAPSINDATA)->getData();
+        auto* const        PGAPSOUT     = (CCssGapData*)(*PGAPSOUTDATA)->getData();
+
+        auto               gapsIn  = WORKSPACERULE.gapsIn.value_or(*PGAPSIN);
+        auto               gapsOut = WORKSPACERULE.gapsOut.value_or(*PGAPSOUT);
+
+        // for gaps outer
+        const bool DISPLAYLEFT   = STICKS(pNode->position.x, PMONITOR->m_position.x + PMONITOR->m_reservedTopLeft.x);
+        const bool DISPLAYRIGHT  = STICKS(pNode->position.x + pNode->size.x, PMONITOR->m_position.x + PMONITOR->m_size.x - PMONITOR->m_reservedBottomRight.x);
+        const bool DISPLAYTOP    = STICKS(pNode->position.y, PMONITOR->m_position.y + PMONITOR->m_reservedTopLeft.y);
+        const bool DISPLAYBOTTOM = STICKS(pNode->position.y + pNode->size.y, PMONITOR->m_position.y + PMONITOR->m_size.y - PMONITOR->m_reservedBottomRight.y);
+
+        auto       calcPos  = pNode->position;
+        auto       calcSize = pNode->size;
+
+        const auto OFFSETTOPLEFT = Vector2D((double)(DISPLAYLEFT ? gapsOut.m_left : gapsIn.m_left), (double)(DISPLAYTOP ? gapsOut.m_top : gapsIn.m_top));
+
+        const auto OFFSETBOTTOMRIGHT = Vector2D((double)(DISPLAYRIGHT ? gapsOut.m_right : gapsIn.m_right), (double)(DISPLAYBOTTOM ? gapsOut.m_bottom : gapsIn.m_bottom));
+
+        calcPos  = calcPos + OFFSETTOPLEFT;
+        calcSize = calcSize - OFFSETTOPLEFT - OFFSETBOTTOMRIGHT;
 
-        int nodeDiv = slavesTotal / numStacks;
-        if (slavesTotal % numStacks && stackNum < slavesTotal % numStacks)
-            nodeDiv++;
-        float NODESIZE = slavesLeft > numStacks ? (stackNodeSizeLeft / nodeDiv) * nd.percSize : nodeSpaceLeft[stackNum];
-        if (NODESIZE > nodeSpaceLeft[stackNum] * 0.9f && slavesLeft > numStacks)
-            NODESIZE = nodeSpaceLeft[stackNum] * 0.9f;
-
-        if (order % 2 && PWORKSPACEDATA->stackNodeCount.size() > nd.stackNum) {
-            NODESIZE = PWORKSPACEDATA->stackNodeCount[nd.stackNum] < nodeDiv - 1 ? (stackNodeSizeLeft / nodeDiv) * nd.percSize : nodeSpaceLeft[stackNum];
-            if (NODESIZE > nodeSpaceLeft[stackNum] * 0.9f && PWORKSPACEDATA->stackNodeCount[nd.stackNum] < nodeDiv - 1)
-                NODESIZE = nodeSpaceLeft[stackNum] * 0.9f;
-        }
+        calcPos  = calcPos + reserved.topLeft;
+        calcSize = calcSize - (reserved.topLeft + reserved.bottomRight);
 
-        nd.stackNum = stackNum + 1;
-        nd.size     = orientation % 2 == 1 ? Vector2D(NODESIZE, stackPos.y - stackPos.x) : Vector2D(stackPos.y - stackPos.x, NODESIZE);
-        PWORKSPACEDATA->stackNodeCount[nd.stackNum]++;
-        slavesLeft--;
-        nodeSpaceLeft[stackNum] -= NODESIZE;
-        nodeNextCoord[stackNum] += NODESIZE;
-        if (order % 2 == 0)
-            stackNum = (slavesTotal - slavesLeft) % numStacks;
-        else if (slavesLeft < numStacks - stackNum)
-            stackNum = numStacks - slavesLeft;
-        else if (nodeSpaceLeft[stackNum] < 1 && stackNum < numStacks - 1)
-            stackNum++;
-        applyNodeDataToWindow(&nd);
+        if (g_pCompositor->isWorkspaceSpecial(pNode->workspaceID))
+            wb = {calcPos + (calcSize - calcSize * PWORKSPACEDATA->special_scale_factor) / 2.f, calcSize * PWORKSPACEDATA->special_scale_factor};
+        else
+            wb = {calcPos, calcSize};
     }
+
+    wb.round(); // avoid rounding mess
+
+    return wb;
 }
 
-void CHyprNstackLayout::applyNodeDataToWindow(SNstackNodeData* pNode) {
+void CHyprNstackLayout::applyNodeGeometry(SNstackNodeData* pNode) {
+    const int  BOXINDEX = std::exchange(pNode->boxIndex, -1);
+    const bool WARP     = std::exchange(pNode->warp, false);
     PHLMONITOR PMONITOR = nullptr;
 
     if (g_pCompositor->isWorkspaceSpecial(pNode->workspaceID)) {
@@ -698,48 +1074,58 @@ void CHyprNstackLayout::applyNodeDataToWindow(SNstackNodeData* pNode) {
         return;
     }
 
-    // for gaps outer
-    const bool DISPLAYLEFT   = STICKS(pNode->position.x, PMONITOR->m_position.x + PMONITOR->m_reservedTopLeft.x);
-    const bool DISPLAYRIGHT  = STICKS(pNode->position.x + pNode->size.x, PMONITOR->m_position.x + PMONITOR->m_size.x - PMONITOR->m_reservedBottomRight.x);
-    const bool DISPLAYTOP    = STICKS(pNode->position.y, PMONITOR->m_position.y + PMONITOR->m_reservedTopLeft.y);
-    const bool DISPLAYBOTTOM = STICKS(pNode->position.y + pNode->size.y, PMONITOR->m_position.y + PMONITOR->m_size.y - PMONITOR->m_reservedBottomRight.y);
+    const auto PWINDOW = pNode->pWindow.lock();
 
-    const auto PWINDOW        = pNode->pWindow.lock();
-    const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-    const auto WORKSPACERULE  = g_pConfigManager->getWorkspaceRuleFor(g_pCompositor->getWorkspaceByID(PWINDOW->workspaceID()));
-
-    if (PWINDOW->isFullscreen() && !pNode->ignoreFullscreenChecks)
+    if (!validMapped(PWINDOW)) {
+        Debug::log(ERR, "Node {} holding invalid window {}!!", pNode, PWINDOW);
         return;
+    }
 
-    PWINDOW->unsetWindowData(PRIORITY_LAYOUT);
-    PWINDOW->updateWindowData();
+    const auto  PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+    const auto& WORKSPACERULE  = PWORKSPACEDATA->rule;
 
-    static auto* const PANIMATE = (Hyprlang::INT* const*)g_pConfigManager->getConfigValuePtr("misc:animate_manual_resizes");
+    if (PWINDOW->isFullscreen() && !pNode->ignoreFullscreenChecks)
+        return;
 
-    static auto* const PGAPSINDATA  = (Hyprlang::CUSTOMTYPE* const*)g_pConfigManager->getConfigValuePtr("general:gaps_in");
-    static auto* const PGAPSOUTDATA = (Hyprlang::CUSTOMTYPE* const*)g_pConfigManager->getConfigValuePtr("general:gaps_out");
-    auto* const        PGAPSIN      = (CCssGapData*)(*PGAPSINDATA)->getData();
-    auto* const        PGAPSOUT     = (CCssGapData*)(*PGAPSOUTDATA)->getData();
+    const bool NOGAPS = PWORKSPACEDATA->no_gaps_when_only && !g_pCompositor->isWorkspaceSpecial(PWINDOW->workspaceID()) &&
+        (getNodesOnWorkspace(PWINDOW->workspaceID()) == 1 || PWINDOW->isEffectiveInternalFSMode(FSMODE_MAXIMIZED));
 
-    auto               gapsIn  = WORKSPACERULE.gapsIn.value_or(*PGAPSIN);
-    auto               gapsOut = WORKSPACERULE.gapsOut.value_or(*PGAPSOUT);
+    SNstackAppliedState target;
+    target.valid  = true;
+    target.noGaps = NOGAPS;
+    if (NOGAPS) {
+        const auto RESERVED = PWINDOW->getFullWindowReservedArea();
+        target.noBorder     = WORKSPACERULE.noBorder.value_or(PWORKSPACEDATA->no_gaps_when_only != 2);
+        target.decorate     = WORKSPACERULE.decorate.value_or(true);
+        target.position     = pNode->position + RESERVED.topLeft;
+        target.size         = pNode->size - (RESERVED.topLeft + RESERVED.bottomRight);
+    } else {
+        const auto WB   = windowBox(pNode, PMONITOR, BOXINDEX, PWINDOW->getFullWindowReservedArea());
+        target.position = WB.pos();
+        target.size     = WB.size();
+    }
 
-    if (!validMapped(PWINDOW)) {
-        Debug::log(ERR, "Node {} holding invalid window {}!!", pNode, PWINDOW);
+    // nothing would change: leave the window data and decorations alone and don't send a configure
+    if (!pNode->dirty && pNode->applied == target && PWINDOW->m_position == pNode->position && PWINDOW->m_size == pNode->size &&
+        PWINDOW->m_realPosition->goal() == target.position && PWINDOW->m_realSize->goal() == target.size) {
+        m_iSkippedWindowUpdates++;
         return;
     }
 
+    PWINDOW->unsetWindowData(PRIORITY_LAYOUT);
+    PWINDOW->updateWindowData();
+
+    static auto* const PANIMATE = (Hyprlang::INT* const*)g_pConfigManager->getConfigValuePtr("misc:animate_manual_resizes");
+
     PWINDOW->m_size     = pNode->size;
     PWINDOW->m_position = pNode->position;
 
     //auto calcPos  = PWINDOW->m_vPosition + Vector2D(*PBORDERSIZE, *PBORDERSIZE);
     //auto calcSize = PWINDOW->m_vSize - Vector2D(2 * *PBORDERSIZE, 2 * *PBORDERSIZE);
 
-    if (PWORKSPACEDATA->no_gaps_when_only && !g_pCompositor->isWorkspaceSpecial(PWINDOW->workspaceID()) &&
-        (getNodesOnWorkspace(PWINDOW->workspaceID()) == 1 || PWINDOW->isEffectiveInternalFSMode(FSMODE_MAXIMIZED))) {
-
-        PWINDOW->m_windowData.noBorder   = CWindowOverridableVar(WORKSPACERULE.noBorder.value_or(PWORKSPACEDATA->no_gaps_when_only != 2), PRIORITY_LAYOUT);
-        PWINDOW->m_windowData.decorate   = CWindowOverridableVar(WORKSPACERULE.decorate.value_or(true), PRIORITY_LAYOUT);
+    if (NOGAPS) {
+        PWINDOW->m_windowData.noBorder   = CWindowOverridableVar(target.noBorder, PRIORITY_LAYOUT);
+        PWINDOW->m_windowData.decorate   = CWindowOverridableVar(target.decorate, PRIORITY_LAYOUT);
         PWINDOW->m_windowData.noRounding = CWindowOverridableVar(true, PRIORITY_LAYOUT);
         PWINDOW->m_windowData.noShadow   = CWindowOverridableVar(true, PRIORITY_LAYOUT);
 
@@ -749,39 +1135,23 @@ void CHyprNstackLayout::applyNodeDataToWindow(SNstackNodeData* pNode) {
         *PWINDOW->m_realPosition = PWINDOW->m_position + RESERVED.topLeft;
         *PWINDOW->m_realSize     = PWINDOW->m_size - (RESERVED.topLeft + RESERVED.bottomRight);
 
+        target.position = PWINDOW->m_realPosition->goal();
+        target.size     = PWINDOW->m_realSize->goal();
+        pNode->applied  = target;
         return;
     }
 
-    auto       calcPos  = PWINDOW->m_position;
-    auto       calcSize = PWINDOW->m_size;
-
-    const auto OFFSETTOPLEFT = Vector2D((double)(DISPLAYLEFT ? gapsOut.m_left : gapsIn.m_left), (double)(DISPLAYTOP ? gapsOut.m_top : gapsIn.m_top));
-
-    const auto OFFSETBOTTOMRIGHT = Vector2D((double)(DISPLAYRIGHT ? gapsOut.m_right : gapsIn.m_right), (double)(DISPLAYBOTTOM ? gapsOut.m_bottom : gapsIn.m_bottom));
-
-    calcPos  = calcPos + OFFSETTOPLEFT;
-    calcSize = calcSize - OFFSETTOPLEFT - OFFSETBOTTOMRIGHT;
-
-    const auto RESERVED = PWINDOW->getFullWindowReservedArea();
-    calcPos             = calcPos + RESERVED.topLeft;
-    calcSize            = calcSize - (RESERVED.topLeft + RESERVED.bottomRight);
+    // the window data was just reset, which can change the reserved area
+    const auto WB = windowBox(pNode, PMONITOR, BOXINDEX, PWINDOW->getFullWindowReservedArea());
 
-    if (g_pCompositor->isWorkspaceSpecial(PWINDOW->workspaceID())) {
+    *PWINDOW->m_realPosition = WB.pos();
+    *PWINDOW->m_realSize     = WB.size();
 
-        CBox wb = {calcPos + (calcSize - calcSize * PWORKSPACEDATA->special_scale_factor) / 2.f, calcSize * PWORKSPACEDATA->special_scale_factor};
-        wb.round(); // avoid rounding mess
+    target.position = WB.pos();
+    target.size     = WB.size();
+    pNode->applied  = target;
 
-        *PWINDOW->m_realPosition = wb.pos();
-        *PWINDOW->m_realSize     = wb.size();
-
-    } else {
-        CBox wb = {calcPos, calcSize};
-        wb.round();
-        *PWINDOW->m_realSize     = wb.size();
-        *PWINDOW->m_realPosition = wb.pos();
-    }
-
-    if (m_bForceWarps && !**PANIMATE) {
+    if ((m_bForceWarps && !**PANIMATE) || WARP) {
         g_pHyprRenderer->damageWindow(PWINDOW);
 
         PWINDOW->m_realPosition->warp();
@@ -798,7 +1168,10 @@ bool CHyprNstackLayout::isWindowTiled(PHLWINDOW pWindow) {
 }
 
 void CHyprNstackLayout::resizeActiveWindow(const Vector2D& pixResize, eRectCorner corner, PHLWINDOW pWindow) {
-    const auto PWINDOW = pWindow ? pWindow : g_pCompositor->m_lastWindow.lock();
+    CNstackStatTimer timer(NSTACK_STAT_RESIZE);
+    CNstackTraceSpan span(NSTACK_TRACE_RESIZE);
+
+    const auto       PWINDOW = pWindow ? pWindow : g_pCompositor->m_lastWindow.lock();
 
     if (!validMapped(PWINDOW))
         return;
@@ -811,11 +1184,18 @@ void CHyprNstackLayout::resizeActiveWindow(const Vector2D& pixResize, eRectCorne
         return;
     }
 
+    if (m_cRecorder.active()) {
+        SNstackRecordEvent event;
+        event.type   = NSTACK_RECORD_RESIZE;
+        event.window = m_cRecorder.windowID(PWINDOW.get());
+        event.delta  = SNstackVec(pixResize.x, pixResize.y);
+        event.arg    = corner;
+        m_cRecorder.record(event);
+    }
+
     // get monitor
     const auto PMONITOR = g_pCompositor->getMonitorFromID(PWINDOW->monitorID());
 
-    m_bForceWarps = true;
-
     const auto PMASTERNODE    = getMasterNodeOnWorkspace(PWINDOW->workspaceID());
     const auto PWORKSPACEDATA = getMasterWorkspaceData(PMONITOR->activeWorkspaceID());
     bool       xResizeDone    = false;
@@ -865,12 +1245,13 @@ void CHyprNstackLayout::resizeActiveWindow(const Vector2D& pixResize, eRectCorne
 
         const auto workspaceIdForResizing = PMONITOR->m_activeSpecialWorkspace ? PMONITOR->activeSpecialWorkspaceID() : PMONITOR->activeWorkspaceID();
 
-        for (auto& n : m_lMasterNodesData) {
-            if (n.isMaster && n.workspaceID == workspaceIdForResizing) {
-                n.percMaster     = std::clamp(n.percMaster + delta, 0.05, 0.95);
-                n.masterAdjusted = true;
+        for (const auto& n : getWorkspaceNodes(workspaceIdForResizing)) {
+            if (n->isMaster) {
+                n->percMaster     = std::clamp(n->percMaster + delta, 0.05, 0.95);
+                n->masterAdjusted = true;
             }
         }
+        touchWorkspaceNodes(workspaceIdForResizing);
     }
 
     if (pixResize.x != 0 && !xResizeDone) {
@@ -909,8 +1290,22 @@ void CHyprNstackLayout::resizeActiveWindow(const Vector2D& pixResize, eRectCorne
         }
     }
 
-    recalculateMonitor(PMONITOR->m_id);
+    touchWorkspaceNodes(PNODE->workspaceID);
+
+    // pointer motion comes in way faster than frames, the deltas above accumulate
+    // and the layout runs once on the monitor's next frame (see onPreRender)
+    m_sPendingResizeMonitors.insert(PMONITOR->m_id);
+    g_pCompositor->scheduleFrameForMonitor(PMONITOR);
+}
+
+void CHyprNstackLayout::onPreRender(PHLMONITOR pMonitor) {
+    if (!pMonitor || !m_sPendingResizeMonitors.erase(pMonitor->m_id))
+        return;
 
+    m_bForceWarps = true;
+    m_eStatOp     = NSTACK_STAT_RESIZE;
+    relayoutMonitor(pMonitor->m_id);
+    m_eStatOp     = NSTACK_STAT_CALCULATE_WORKSPACE;
     m_bForceWarps = false;
 }
 
@@ -918,6 +1313,15 @@ void CHyprNstackLayout::fullscreenRequestForWindow(PHLWINDOW pWindow, const eFul
     const auto PMONITOR   = pWindow->m_monitor.lock();
     const auto PWORKSPACE = pWindow->m_workspace;
 
+    if (m_cRecorder.active() && getNodeFromWindow(pWindow)) {
+        SNstackRecordEvent event;
+        event.type   = NSTACK_RECORD_FULLSCREEN;
+        event.window = m_cRecorder.windowID(pWindow.get());
+        event.arg    = CURRENT_EFFECTIVE_MODE;
+        event.arg2   = EFFECTIVE_MODE;
+        m_cRecorder.record(event);
+    }
+
     // save position and size if floating
     if (pWindow->m_isFloating && CURRENT_EFFECTIVE_MODE == FSMODE_NONE) {
         pWindow->m_lastFloatingSize     = pWindow->m_realSize->goal();
@@ -927,11 +1331,19 @@ void CHyprNstackLayout::fullscreenRequestForWindow(PHLWINDOW pWindow, const eFul
     }
 
     if (EFFECTIVE_MODE == FSMODE_NONE) {
+        const auto PWORKSPACEDATA        = getMasterWorkspaceData(pWindow->workspaceID());
+        PWORKSPACEDATA->fullscreenNode   = SNstackNodeData{};
+        PWORKSPACEDATA->fullscreenExited = true;
+
         // if it got its fullscreen disabled, set back its node if it had one
         const auto PNODE = getNodeFromWindow(pWindow);
-        if (PNODE)
-            applyNodeDataToWindow(PNODE);
-        else {
+        if (PNODE) {
+            // Hyprland still has the workspace marked fullscreen here and recalculates the monitor
+            // right after, which lays out the tiles left alone meanwhile and places this window once.
+            // The deferred relayout only runs if that didn't happen
+            PNODE->dirty = true;
+            scheduleRelayout(pWindow->monitorID());
+        } else {
             // get back its' dimensions from position and size
             *pWindow->m_realPosition = pWindow->m_lastFloatingPosition;
             *pWindow->m_realSize     = pWindow->m_lastFloatingSize;
@@ -971,7 +1383,9 @@ void CHyprNstackLayout::recalculateWindow(PHLWINDOW pWindow) {
     if (!PNODE)
         return;
 
-    recalculateMonitor(pWindow->monitorID());
+    // asked for explicitly (e.g. decorations changed), so reapply even if the box stays
+    PNODE->dirty = true;
+    scheduleRelayout(pWindow->monitorID());
 }
 
 SWindowRenderLayoutHints CHyprNstackLayout::requestRenderHints(PHLWINDOW pWindow) {
@@ -993,18 +1407,25 @@ void CHyprNstackLayout::switchWindows(PHLWINDOW pWindow, PHLWINDOW pWindow2) {
     if (!PNODE2 || !PNODE)
         return;
 
+    if (m_cRecorder.active()) {
+        SNstackRecordEvent event;
+        event.type    = NSTACK_RECORD_SWITCH_WINDOWS;
+        event.window  = m_cRecorder.windowID(pWindow.get());
+        event.window2 = m_cRecorder.windowID(pWindow2.get());
+        m_cRecorder.record(event);
+    }
+
     if (PNODE->workspaceID != PNODE2->workspaceID) {
         std::swap(pWindow2->m_monitor, pWindow->m_monitor);
         std::swap(pWindow2->m_workspace, pWindow->m_workspace);
     }
 
     // massive hack: just swap window pointers, lol
-    PNODE->pWindow  = pWindow2;
-    PNODE2->pWindow = pWindow;
+    swapNodeWindows(PNODE, PNODE2);
 
-    recalculateMonitor(pWindow->monitorID());
+    scheduleRelayout(pWindow->monitorID());
     if (PNODE2->workspaceID != PNODE->workspaceID)
-        recalculateMonitor(pWindow2->monitorID());
+        scheduleRelayout(pWindow2->monitorID());
 
     g_pHyprRenderer->damageWindow(pWindow);
     g_pHyprRenderer->damageWindow(pWindow2);
@@ -1023,8 +1444,9 @@ void CHyprNstackLayout::alterSplitRatio(PHLWINDOW pWindow, float ratio, bool exa
     float      newRatio     = exact ? ratio : PMASTER->percMaster + ratio;
     PMASTER->percMaster     = std::clamp(newRatio, 0.05f, 0.95f);
     PMASTER->masterAdjusted = true;
+    touchWorkspaceNodes(PMASTER->workspaceID);
 
-    recalculateMonitor(pWindow->monitorID());
+    scheduleRelayout(pWindow->monitorID());
 }
 
 PHLWINDOW CHyprNstackLayout::getNextWindow(PHLWINDOW pWindow, bool next) {
@@ -1032,396 +1454,575 @@ PHLWINDOW CHyprNstackLayout::getNextWindow(PHLWINDOW pWindow, bool next) {
         return nullptr;
 
     const auto PNODE = getNodeFromWindow(pWindow);
+    auto&      ws    = m_mWorkspaceNodes[PNODE->workspaceID];
+
+    if (!ws.kindsValid) {
+        ws.masterNodes.clear();
+        ws.slaveNodes.clear();
+        for (const auto& n : getWorkspaceNodes(PNODE->workspaceID)) {
+            auto& kind   = n->isMaster ? ws.masterNodes : ws.slaveNodes;
+            n->kindIndex = kind.size();
+            kind.push_back(n->handle);
+        }
+        ws.kindsValid = true;
+    }
 
-    auto       nodes = m_lMasterNodesData;
-    if (!next)
-        std::reverse(nodes.begin(), nodes.end());
-
-    const auto NODEIT = std::find(nodes.begin(), nodes.end(), *PNODE);
+    // next of the same kind, otherwise wrap around to the first (last when going back) of the other kind
+    const auto& SAME   = PNODE->isMaster ? ws.masterNodes : ws.slaveNodes;
+    const auto& OTHER  = PNODE->isMaster ? ws.slaveNodes : ws.masterNodes;
+    const int   IDX    = PNODE->kindIndex + (next ? 1 : -1);
+    const auto  WINDOW = [this](const SNstackHandle& h) -> PHLWINDOW {
+        const auto n = getNode(h);
+        return n ? n->pWindow.lock() : nullptr;
+    };
 
-    const bool ISMASTER = PNODE->isMaster;
+    if (IDX >= 0 && IDX < (int)SAME.size())
+        return WINDOW(SAME[IDX]);
 
-    auto CANDIDATE = std::find_if(NODEIT, nodes.end(), [&](const auto& other) { return other != *PNODE && ISMASTER == other.isMaster && other.workspaceID == PNODE->workspaceID; });
-    if (CANDIDATE == nodes.end())
-        CANDIDATE =
-            std::find_if(nodes.begin(), nodes.end(), [&](const auto& other) { return other != *PNODE && ISMASTER != other.isMaster && other.workspaceID == PNODE->workspaceID; });
+    if (OTHER.empty())
+        return nullptr;
 
-    return CANDIDATE == nodes.end() ? nullptr : CANDIDATE->pWindow.lock();
+    return WINDOW(next ? OTHER.front() : OTHER.back());
 }
 
-std::any CHyprNstackLayout::layoutMessage(SLayoutMessageHeader header, std::string message) {
-    auto switchToWindow = [&](PHLWINDOW PWINDOWTOCHANGETO) {
-        if (!validMapped(PWINDOWTOCHANGETO))
-            return;
+// the tile next to pWindow's in direction, nullptr at the edge of its workspace
+PHLWINDOW CHyprNstackLayout::getWindowInDirection(PHLWINDOW pWindow, eNstackDirection direction) {
+    if (!isWindowTiled(pWindow))
+        return nullptr;
 
-        if (header.pWindow->isFullscreen()) {
-            const auto PWORKSPACE    = header.pWindow->m_workspace;
-            const auto FSMODE        = header.pWindow->m_fullscreenState.internal;
-            const auto WORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
-            g_pCompositor->setWindowFullscreenInternal(header.pWindow, FSMODE_NONE);
-            g_pCompositor->focusWindow(PWINDOWTOCHANGETO);
-            if (WORKSPACEDATA->inherit_fullscreen)
-                g_pCompositor->setWindowFullscreenInternal(PWINDOWTOCHANGETO, FSMODE);
+    // the index is built from the nodes' boxes, so they have to be current
+    flushPendingRelayouts();
 
-        } else {
-            g_pCompositor->focusWindow(PWINDOWTOCHANGETO);
-            g_pCompositor->warpCursorTo(PWINDOWTOCHANGETO->middle());
+    const auto PNODE = getNodeFromWindow(pWindow);
+    if (!PNODE)
+        return nullptr;
+
+    auto& ws = m_mWorkspaceNodes[PNODE->workspaceID];
+
+    if (!ws.spatialValid) {
+        std::vector<SNstackSpatialTile> tiles;
+        tiles.reserve(ws.nodes.size());
+        ws.spatialNodes.clear();
+        for (const auto& n : getWorkspaceNodes(PNODE->workspaceID)) {
+            n->tileIndex = tiles.size();
+            tiles.push_back({toNstackVec(n->position), toNstackVec(n->size), n->isMaster ? 0 : n->stackNum});
+            ws.spatialNodes.push_back(n->handle);
         }
-        g_pInputManager->m_forcedFocus = PWINDOWTOCHANGETO;
-        g_pInputManager->simulateMouseMovement();
-        g_pInputManager->m_forcedFocus.reset();
-    };
+        ws.spatial.build(tiles, getMasterWorkspaceData(PNODE->workspaceID)->orientation % 2 == 0);
+        ws.spatialValid = true;
+    }
 
-    auto refreshWindows = [&](PHLWINDOW ORIGINALWINDOW) {
-        // TODO: this is probably a dumb way to force update window sizes, but the bastards refuse the update without interaction
-        for (auto& n : m_lMasterNodesData) {
-            if (n.workspaceID == header.pWindow->workspaceID() && !n.isMaster && !n.pWindow->m_isFloating) {
-                switchToWindow(n.pWindow.lock());
-            }
+    const int  TILE       = ws.spatial.neighbour(PNODE->tileIndex, direction);
+    const auto PNEIGHBOUR = TILE < 0 ? nullptr : getNode(ws.spatialNodes[TILE]);
+    return PNEIGHBOUR ? PNEIGHBOUR->pWindow.lock() : nullptr;
+}
+
+void CHyprNstackLayout::switchToWindow(SLayoutMessageHeader& header, PHLWINDOW PWINDOWTOCHANGETO) {
+    if (!validMapped(PWINDOWTOCHANGETO))
+        return;
+
+    // the cursor is warped to the window, so its box has to be current
+    flushPendingRelayouts();
+
+    if (header.pWindow->isFullscreen()) {
+        const auto PWORKSPACE    = header.pWindow->m_workspace;
+        const auto FSMODE        = header.pWindow->m_fullscreenState.internal;
+        const auto WORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+        g_pCompositor->setWindowFullscreenInternal(header.pWindow, FSMODE_NONE);
+        g_pCompositor->focusWindow(PWINDOWTOCHANGETO);
+        if (WORKSPACEDATA->inherit_fullscreen)
+            g_pCompositor->setWindowFullscreenInternal(PWINDOWTOCHANGETO, FSMODE);
+
+    } else {
+        g_pCompositor->focusWindow(PWINDOWTOCHANGETO);
+        g_pCompositor->warpCursorTo(PWINDOWTOCHANGETO->middle());
+    }
+    g_pInputManager->m_forcedFocus = PWINDOWTOCHANGETO;
+    g_pInputManager->simulateMouseMovement();
+    g_pInputManager->m_forcedFocus.reset();
+}
+
+void CHyprNstackLayout::refreshWindows(SLayoutMessageHeader& header, PHLWINDOW ORIGINALWINDOW) {
+    // TODO: this is probably a dumb way to force update window sizes, but the bastards refuse the update without interaction
+    for (const auto& n : getWorkspaceNodes(header.pWindow->workspaceID())) {
+        if (!n->isMaster && !n->pWindow->m_isFloating) {
+            switchToWindow(header, n->pWindow.lock());
         }
-        switchToWindow(ORIGINALWINDOW);
-    };
+    }
+    switchToWindow(header, ORIGINALWINDOW);
+}
+
+std::any CHyprNstackLayout::layoutMessage(SLayoutMessageHeader header, std::string message) {
+    CNstackStatTimer timer(NSTACK_STAT_LAYOUTMSG);
+    CNstackTraceSpan span(NSTACK_TRACE_LAYOUTMSG);
 
-    CVarList vars(message, 0, ' ');
+    CVarList         vars(message, 0, ' ');
 
     if (vars.size() < 1 || vars[0].empty()) {
         Debug::log(ERR, "layoutmsg called without params");
         return 0;
     }
 
-    auto command = vars[0];
+    if (m_cRecorder.active() && vars[0] != "record") {
+        SNstackRecordEvent event;
+        event.type    = NSTACK_RECORD_LAYOUTMSG;
+        event.window  = m_cRecorder.windowID(header.pWindow.get());
+        event.message = message;
+        m_cRecorder.record(event);
+    }
 
-    // swapwithmaster <master | child | auto>
-    // first message argument can have the following values:
-    // * master - keep the focus at the new master
-    // * child - keep the focus at the new child
-    // * auto (default) - swap the focus (keep the focus of the previously selected window)
-    if (command == "swapwithmaster") {
-        const auto PWINDOW = header.pWindow;
+    SNstackMessageBatch batch;
+    m_eStatOp = NSTACK_STAT_LAYOUTMSG;
+
+    // batch <command>; <command>; ...
+    // runs every command first, then lays out and refreshes each affected monitor once
+    if (vars[0] == "batch") {
+        CVarList commands(vars.join(" ", 1), 0, ';', true);
+        for (const auto& c : commands) {
+            CVarList commandVars(c, 0, ' ');
+            if (commandVars.size() < 1 || commandVars[0].empty() || commandVars[0] == "batch") {
+                Debug::log(ERR, "Nstack layoutmsg batch: invalid command \"{}\"", c);
+                continue;
+            }
+            runLayoutMessage(header, commandVars, batch);
+        }
+    } else
+        runLayoutMessage(header, vars, batch);
 
-        if (!PWINDOW)
-            return 0;
+    for (const auto& m : batch.monitors)
+        recalculateMonitor(m);
 
-        if (!isWindowTiled(PWINDOW))
-            return 0;
+    if (batch.refreshWindow)
+        refreshWindows(header, batch.refreshWindow);
 
-        const auto PMASTER = getMasterNodeOnWorkspace(PWINDOW->workspaceID());
+    // swaps are deferred, but a dispatch should be done once it returns
+    flushPendingRelayouts();
 
-        if (!PMASTER)
-            return 0;
+    m_eStatOp = NSTACK_STAT_CALCULATE_WORKSPACE;
 
-        const auto NEWCHILD = PMASTER->pWindow.lock();
+    return 0;
+}
 
-        if (PMASTER->pWindow.lock() != PWINDOW) {
-            const auto NEWMASTER       = PWINDOW;
-            const bool newFocusToChild = vars.size() >= 2 && vars[1] == "child";
-            switchWindows(NEWMASTER, NEWCHILD);
-            const auto NEWFOCUS = newFocusToChild ? NEWCHILD : NEWMASTER;
-            switchToWindow(NEWFOCUS);
-        } else {
-            for (auto& n : m_lMasterNodesData) {
-                if (n.workspaceID == PMASTER->workspaceID && !n.isMaster) {
-                    const auto NEWMASTER = n.pWindow.lock();
-                    switchWindows(NEWMASTER, NEWCHILD);
-                    const bool newFocusToMaster = vars.size() >= 2 && vars[1] == "master";
-                    const auto NEWFOCUS         = newFocusToMaster ? NEWMASTER : NEWCHILD;
-                    switchToWindow(NEWFOCUS);
-                    break;
-                }
-            }
-        }
+void CHyprNstackLayout::runLayoutMessage(SLayoutMessageHeader& header, CVarList& vars, SNstackMessageBatch& batch) {
+    const auto COMMAND = nstackLookupCommand(vars[0]);
 
-        return 0;
-    }
-    // focusmaster <master | auto>
-    // first message argument can have the following values:
-    // * master - keep the focus at the new master, even if it was focused before
-    // * auto (default) - swap the focus with the first child, if the current focus was master, otherwise focus master
-    else if (command == "focusmaster") {
-        const auto PWINDOW = header.pWindow;
+    switch (COMMAND) {
+        // swapwithmaster <master | child | auto>
+        // first message argument can have the following values:
+        // * master - keep the focus at the new master
+        // * child - keep the focus at the new child
+        // * auto (default) - swap the focus (keep the focus of the previously selected window)
+        case NSTACK_CMD_SWAPWITHMASTER: {
+            const auto PWINDOW = header.pWindow;
 
-        if (!PWINDOW)
-            return 0;
+            if (!PWINDOW)
+                return;
 
-        const auto PMASTER = getMasterNodeOnWorkspace(PWINDOW->workspaceID());
+            if (!isWindowTiled(PWINDOW))
+                return;
 
-        if (!PMASTER)
-            return 0;
+            const auto PMASTER = getMasterNodeOnWorkspace(PWINDOW->workspaceID());
 
-        if (PMASTER->pWindow.lock() != PWINDOW) {
-            switchToWindow(PMASTER->pWindow.lock());
-        } else if (vars.size() >= 2 && vars[1] == "master") {
-            return 0;
-        } else {
-            // if master is focused keep master focused (don't do anything)
-            for (auto& n : m_lMasterNodesData) {
-                if (n.workspaceID == PMASTER->workspaceID && !n.isMaster) {
-                    switchToWindow(n.pWindow.lock());
-                    break;
+            if (!PMASTER)
+                return;
+
+            const auto NEWCHILD = PMASTER->pWindow.lock();
+
+            if (PMASTER->pWindow.lock() != PWINDOW) {
+                const auto NEWMASTER       = PWINDOW;
+                const bool newFocusToChild = vars.size() >= 2 && vars[1] == "child";
+                switchWindows(NEWMASTER, NEWCHILD);
+                const auto NEWFOCUS = newFocusToChild ? NEWCHILD : NEWMASTER;
+                switchToWindow(header, NEWFOCUS);
+            } else {
+                for (const auto& n : getWorkspaceNodes(PMASTER->workspaceID)) {
+                    if (!n->isMaster) {
+                        const auto NEWMASTER = n->pWindow.lock();
+                        switchWindows(NEWMASTER, NEWCHILD);
+                        const bool newFocusToMaster = vars.size() >= 2 && vars[1] == "master";
+                        const auto NEWFOCUS         = newFocusToMaster ? NEWMASTER : NEWCHILD;
+                        switchToWindow(header, NEWFOCUS);
+                        break;
+                    }
                 }
             }
+            break;
         }
+        // focusmaster <master | auto>
+        // first message argument can have the following values:
+        // * master - keep the focus at the new master, even if it was focused before
+        // * auto (default) - swap the focus with the first child, if the current focus was master, otherwise focus master
+        case NSTACK_CMD_FOCUSMASTER: {
+            const auto PWINDOW = header.pWindow;
 
-        return 0;
-    } else if (command == "cyclenext") {
-        const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
 
-        if (!PWINDOW)
-            return 0;
+            const auto PMASTER = getMasterNodeOnWorkspace(PWINDOW->workspaceID());
 
-        const auto PNEXTWINDOW = getNextWindow(PWINDOW, true);
-        switchToWindow(PNEXTWINDOW);
-    } else if (command == "cycleprev") {
-        const auto PWINDOW = header.pWindow;
+            if (!PMASTER)
+                return;
 
-        if (!PWINDOW)
-            return 0;
+            if (PMASTER->pWindow.lock() != PWINDOW) {
+                switchToWindow(header, PMASTER->pWindow.lock());
+            } else if (vars.size() >= 2 && vars[1] == "master") {
+                return;
+            } else {
+                // if master is focused keep master focused (don't do anything)
+                for (const auto& n : getWorkspaceNodes(PMASTER->workspaceID)) {
+                    if (!n->isMaster) {
+                        switchToWindow(header, n->pWindow.lock());
+                        break;
+                    }
+                }
+            }
+            break;
+        }
+        case NSTACK_CMD_CYCLENEXT:
+        case NSTACK_CMD_CYCLEPREV: {
+            const auto PWINDOW = header.pWindow;
 
-        const auto PPREVWINDOW = getNextWindow(PWINDOW, false);
-        switchToWindow(PPREVWINDOW);
-    } else if (command == "swapnext") {
-        if (!validMapped(header.pWindow))
-            return 0;
+            if (!PWINDOW)
+                return;
 
-        if (header.pWindow->m_isFloating) {
-            g_pKeybindManager->m_dispatchers["swapnext"]("");
-            return 0;
+            switchToWindow(header, getNextWindow(PWINDOW, COMMAND == NSTACK_CMD_CYCLENEXT));
+            break;
         }
+        case NSTACK_CMD_SWAPNEXT:
+        case NSTACK_CMD_SWAPPREV: {
+            const bool NEXT = COMMAND == NSTACK_CMD_SWAPNEXT;
 
-        const auto PWINDOWTOSWAPWITH = getNextWindow(header.pWindow, true);
+            if (!validMapped(header.pWindow))
+                return;
 
-        if (PWINDOWTOSWAPWITH) {
-            switchWindows(header.pWindow, PWINDOWTOSWAPWITH);
-            g_pCompositor->focusWindow(header.pWindow);
-        }
-    } else if (command == "swapprev") {
-        if (!validMapped(header.pWindow))
-            return 0;
+            if (header.pWindow->m_isFloating) {
+                g_pKeybindManager->m_dispatchers["swapnext"](NEXT ? "" : "prev");
+                return;
+            }
 
-        if (header.pWindow->m_isFloating) {
-            g_pKeybindManager->m_dispatchers["swapnext"]("prev");
-            return 0;
+            const auto PWINDOWTOSWAPWITH = getNextWindow(header.pWindow, NEXT);
+
+            if (PWINDOWTOSWAPWITH) {
+                switchWindows(header.pWindow, PWINDOWTOSWAPWITH);
+                g_pCompositor->focusWindow(header.pWindow);
+            }
+            break;
         }
+        // focusdir <l | r | u | d>
+        case NSTACK_CMD_FOCUSDIR: {
+            const auto PWINDOW   = header.pWindow;
+            const auto DIRECTION = vars.size() >= 2 ? nstackParseDirection(vars[1]) : NSTACK_DIRECTION_INVALID;
 
-        const auto PWINDOWTOSWAPWITH = getNextWindow(header.pWindow, false);
+            if (!PWINDOW || DIRECTION == NSTACK_DIRECTION_INVALID)
+                return;
 
-        if (PWINDOWTOSWAPWITH) {
-            switchWindows(header.pWindow, PWINDOWTOSWAPWITH);
-            g_pCompositor->focusWindow(header.pWindow);
+            switchToWindow(header, getWindowInDirection(PWINDOW, DIRECTION));
+            break;
         }
-    } else if (command == "addmaster") {
-        if (!validMapped(header.pWindow))
-            return 0;
+        // swapdir <l | r | u | d>
+        case NSTACK_CMD_SWAPDIR: {
+            const auto DIRECTION = vars.size() >= 2 ? nstackParseDirection(vars[1]) : NSTACK_DIRECTION_INVALID;
 
-        if (header.pWindow->m_isFloating)
-            return 0;
+            if (!validMapped(header.pWindow) || header.pWindow->m_isFloating || DIRECTION == NSTACK_DIRECTION_INVALID)
+                return;
 
-        const auto PNODE = getNodeFromWindow(header.pWindow);
+            const auto PWINDOWTOSWAPWITH = getWindowInDirection(header.pWindow, DIRECTION);
 
-        if (!PNODE || PNODE->isMaster) {
-            // first non-master node
-            for (auto& n : m_lMasterNodesData) {
-                if (n.workspaceID == header.pWindow->workspaceID() && !n.isMaster) {
-                    n.isMaster = true;
-                    break;
+            if (PWINDOWTOSWAPWITH) {
+                switchWindows(header.pWindow, PWINDOWTOSWAPWITH);
+                g_pCompositor->focusWindow(header.pWindow);
+            }
+            break;
+        }
+        case NSTACK_CMD_ADDMASTER: {
+            if (!validMapped(header.pWindow))
+                return;
+
+            if (header.pWindow->m_isFloating)
+                return;
+
+            const auto PNODE = getNodeFromWindow(header.pWindow);
+
+            if (!PNODE || PNODE->isMaster) {
+                // first non-master node
+                for (const auto& n : getWorkspaceNodes(header.pWindow->workspaceID())) {
+                    if (!n->isMaster) {
+                        setNodeMaster(n, true);
+                        break;
+                    }
                 }
+            } else {
+                setNodeMaster(PNODE, true);
             }
-        } else {
-            PNODE->isMaster = true;
+
+            batch.monitors.insert(header.pWindow->monitorID());
+            break;
         }
+        case NSTACK_CMD_REMOVEMASTER: {
+            if (!validMapped(header.pWindow))
+                return;
 
-        recalculateMonitor(header.pWindow->monitorID());
+            if (header.pWindow->m_isFloating)
+                return;
 
-    } else if (command == "removemaster") {
+            const auto PNODE = getNodeFromWindow(header.pWindow);
 
-        if (!validMapped(header.pWindow))
-            return 0;
+            const auto WINDOWS = getNodesOnWorkspace(header.pWindow->workspaceID());
+            const auto MASTERS = getMastersOnWorkspace(header.pWindow->workspaceID());
+
+            if (WINDOWS < 2 || MASTERS < 2)
+                return;
+
+            if (!PNODE || !PNODE->isMaster) {
+                // first non-master node
+                for (const auto& n : getWorkspaceNodes(header.pWindow->workspaceID()) | std::views::reverse) {
+                    if (n->isMaster) {
+                        setNodeMaster(n, false);
+                        break;
+                    }
+                }
+            } else {
+                setNodeMaster(PNODE, false);
+            }
 
-        if (header.pWindow->m_isFloating)
-            return 0;
+            batch.monitors.insert(header.pWindow->monitorID());
+            break;
+        }
+        case NSTACK_CMD_TOGGLEMASTER: {
+            if (!validMapped(header.pWindow))
+                return;
 
-        const auto PNODE = getNodeFromWindow(header.pWindow);
+            if (header.pWindow->m_isFloating)
+                return;
 
-        const auto WINDOWS = getNodesOnWorkspace(header.pWindow->workspaceID());
-        const auto MASTERS = getMastersOnWorkspace(header.pWindow->workspaceID());
+            const auto PNODE   = getNodeFromWindow(header.pWindow);
+            const auto MASTERS = getMastersOnWorkspace(header.pWindow->workspaceID());
 
-        if (WINDOWS < 2 || MASTERS < 2)
-            return 0;
+            if (PNODE && (!PNODE->isMaster || MASTERS > 1))
+                setNodeMaster(PNODE, !PNODE->isMaster);
+            batch.monitors.insert(header.pWindow->monitorID());
+            break;
+        }
+        case NSTACK_CMD_ORIENTATIONLEFT:
+        case NSTACK_CMD_ORIENTATIONRIGHT:
+        case NSTACK_CMD_ORIENTATIONTOP:
+        case NSTACK_CMD_ORIENTATIONBOTTOM:
+        case NSTACK_CMD_ORIENTATIONHCENTER:
+        case NSTACK_CMD_ORIENTATIONVCENTER: {
+            const auto PWINDOW = header.pWindow;
+
+            if (!PWINDOW)
+                return;
+
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+
+            switch (COMMAND) {
+                case NSTACK_CMD_ORIENTATIONLEFT: PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_LEFT; break;
+                case NSTACK_CMD_ORIENTATIONRIGHT: PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_RIGHT; break;
+                case NSTACK_CMD_ORIENTATIONTOP: PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_TOP; break;
+                case NSTACK_CMD_ORIENTATIONBOTTOM: PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_BOTTOM; break;
+                case NSTACK_CMD_ORIENTATIONHCENTER: PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_HCENTER; break;
+                case NSTACK_CMD_ORIENTATIONVCENTER: PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_VCENTER; break;
+                default: break;
+            }
 
-        if (!PNODE || !PNODE->isMaster) {
-            // first non-master node
-            for (auto it = m_lMasterNodesData.rbegin(); it != m_lMasterNodesData.rend(); it++) {
-                if (it->workspaceID == header.pWindow->workspaceID() && it->isMaster) {
-                    it->isMaster = false;
+            PWORKSPACEDATA->overrides |= nstackOptionBit(NSTACK_OPTION_ORIENTATION);
+            batch.monitors.insert(header.pWindow->monitorID());
+            break;
+        }
+        case NSTACK_CMD_ORIENTATIONNEXT:
+        case NSTACK_CMD_ORIENTATIONPREV:
+        case NSTACK_CMD_ORIENTATIONCYCLE: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+            PWORKSPACEDATA->overrides |= nstackOptionBit(NSTACK_OPTION_ORIENTATION);
+            runOrientationCycle(header, COMMAND == NSTACK_CMD_ORIENTATIONCYCLE ? &vars : nullptr, COMMAND == NSTACK_CMD_ORIENTATIONPREV ? -1 : 1);
+            batch.monitors.insert(PWINDOW->monitorID());
+            break;
+        }
+        case NSTACK_CMD_RESETSPLITS: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            resetNodeSplits(PWINDOW->workspaceID());
+            batch.monitors.insert(PWINDOW->monitorID());
+            break;
+        }
+        case NSTACK_CMD_RESETOVERRIDES: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+            if (!PWORKSPACEDATA)
+                return;
+            PWORKSPACEDATA->overrides    = 0;
+            PWORKSPACEDATA->optionsValid = false;
+            batch.monitors.insert(PWINDOW->monitorID());
+            break;
+        }
+        case NSTACK_CMD_SETSTACKCOUNT: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+            if (!PWORKSPACEDATA)
+                return;
+
+            if (vars.size() >= 2) {
+                int newStackCount = 2;
+                try {
+                    switch (vars[1][0]) {
+                        case '+':
+                        case '-': newStackCount = PWORKSPACEDATA->m_iStackCount + std::stoi(vars[1]); break;
+                        default: newStackCount = std::stoi(vars[1]); break;
+                    }
+                } catch (std::exception& e) {
+                    Debug::log(ERR, "Nstack layoutmsg setstackcount format error: {}", e.what());
                     break;
                 }
+                if (newStackCount) {
+                    nstackSetOption(NSTACK_OPTIONS[NSTACK_OPTION_STACKS], *PWORKSPACEDATA, newStackCount);
+                    PWORKSPACEDATA->overrides |= nstackOptionBit(NSTACK_OPTION_STACKS);
+                    batch.monitors.insert(PWINDOW->monitorID());
+                    batch.refreshWindow = PWINDOW;
+                }
             }
-        } else {
-            PNODE->isMaster = false;
+            break;
         }
+        case NSTACK_CMD_ORDERROW:
+        case NSTACK_CMD_ORDERCOLUMN:
+        case NSTACK_CMD_ORDERRROW:
+        case NSTACK_CMD_ORDERRCOLUMN:
+        case NSTACK_CMD_ORDERNEXT:
+        case NSTACK_CMD_ORDERPREV: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+            if (!PWORKSPACEDATA)
+                return;
+
+            switch (COMMAND) {
+                case NSTACK_CMD_ORDERROW: PWORKSPACEDATA->order = NSTACK_ORDER_ROW; break;
+                case NSTACK_CMD_ORDERCOLUMN: PWORKSPACEDATA->order = NSTACK_ORDER_COLUMN; break;
+                case NSTACK_CMD_ORDERRROW: PWORKSPACEDATA->order = NSTACK_ORDER_RROW; break;
+                case NSTACK_CMD_ORDERRCOLUMN: PWORKSPACEDATA->order = NSTACK_ORDER_RCOLUMN; break;
+                case NSTACK_CMD_ORDERNEXT: PWORKSPACEDATA->order = (eColOrder)(((int)PWORKSPACEDATA->order + 1) % 4); break;
+                case NSTACK_CMD_ORDERPREV: PWORKSPACEDATA->order = (eColOrder)(((int)PWORKSPACEDATA->order + 3) % 4); break;
+                default: break;
+            }
 
-        recalculateMonitor(header.pWindow->monitorID());
-    } else if (command == "togglemaster") {
-        if (!validMapped(header.pWindow))
-            return 0;
-
-        if (header.pWindow->m_isFloating)
-            return 0;
-
-        const auto PNODE   = getNodeFromWindow(header.pWindow);
-        const auto MASTERS = getMastersOnWorkspace(header.pWindow->workspaceID());
-
-        if (PNODE && (!PNODE->isMaster || MASTERS > 1))
-            PNODE->isMaster ^= true;
-        recalculateMonitor(header.pWindow->monitorID());
-    } else if (command == "orientationleft" || command == "orientationright" || command == "orientationtop" || command == "orientationbottom" || command == "orientationcenter" ||
-               command == "orientationhcenter" || command == "orientationvcenter") {
-        const auto PWINDOW = header.pWindow;
-
-        if (!PWINDOW)
-            return 0;
-
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-
-        if (command == "orientationleft")
-            PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_LEFT;
-        else if (command == "orientationright")
-            PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_RIGHT;
-        else if (command == "orientationtop")
-            PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_TOP;
-        else if (command == "orientationbottom")
-            PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_BOTTOM;
-        else if (command == "orientationcenter" || command == "orientationhcenter")
-            PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_HCENTER;
-        else if (command == "orientationvcenter")
-            PWORKSPACEDATA->orientation = NSTACK_ORIENTATION_VCENTER;
-
-        PWORKSPACEDATA->overrides.emplace("orientation");
-        recalculateMonitor(header.pWindow->monitorID());
-
-    } else if (command == "orientationnext") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        PWORKSPACEDATA->overrides.emplace("orientation");
-        runOrientationCycle(header, nullptr, 1);
-    } else if (command == "orientationprev") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        PWORKSPACEDATA->overrides.emplace("orientation");
-        runOrientationCycle(header, nullptr, -1);
-    } else if (command == "orientationcycle") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        PWORKSPACEDATA->overrides.emplace("orientation");
-        runOrientationCycle(header, &vars, 1);
-    } else if (command == "resetsplits") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        resetNodeSplits(PWINDOW->workspaceID());
-    } else if (command == "resetoverrides") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        if (!PWORKSPACEDATA)
-            return 0;
-        PWORKSPACEDATA->overrides.clear();
-        recalculateMonitor(PWINDOW->monitorID());
-    } else if (command == "setstackcount") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        if (!PWORKSPACEDATA)
-            return 0;
-
-        if (vars.size() >= 2) {
-            int newStackCount = 2;
-            switch (vars[1][0]) {
-                case '+':
-                case '-': newStackCount = PWORKSPACEDATA->m_iStackCount + std::stoi(vars[1]); break;
-                default: newStackCount = std::stoi(vars[1]); break;
+            PWORKSPACEDATA->overrides |= nstackOptionBit(NSTACK_OPTION_ORDER);
+            batch.monitors.insert(PWINDOW->monitorID());
+            batch.refreshWindow = PWINDOW;
+            break;
+        }
+        case NSTACK_CMD_MFACT: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+            if (!PWORKSPACEDATA)
+                return;
+            if (vars.size() >= 2) {
+                try {
+                    nstackSetOption(NSTACK_OPTIONS[NSTACK_OPTION_MFACT], *PWORKSPACEDATA, std::stof(vars[1]));
+                    PWORKSPACEDATA->overrides |= nstackOptionBit(NSTACK_OPTION_MFACT);
+                    batch.monitors.insert(PWINDOW->monitorID());
+                } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutmsg mfact format error: {}", e.what()); }
+            } else {
+                PWORKSPACEDATA->overrides &= ~nstackOptionBit(NSTACK_OPTION_MFACT);
+                PWORKSPACEDATA->optionsValid = false;
+                batch.monitors.insert(PWINDOW->monitorID());
             }
-            if (newStackCount) {
-                if (newStackCount < 2)
-                    newStackCount = 2;
-                PWORKSPACEDATA->m_iStackCount = newStackCount;
-                PWORKSPACEDATA->overrides.emplace("stacks");
-                recalculateMonitor(PWINDOW->monitorID());
-                refreshWindows(PWINDOW);
+            break;
+        }
+        case NSTACK_CMD_TOGGLEMFACT: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+            if (!PWORKSPACEDATA)
+                return;
+            if (vars.size() >= 2) {
+                try {
+                    auto wsmfact = std::stof(vars[1]);
+                    if (PWORKSPACEDATA->master_factor == wsmfact) {
+                        PWORKSPACEDATA->master_factor = 0;
+                        PWORKSPACEDATA->overrides &= ~nstackOptionBit(NSTACK_OPTION_MFACT);
+                        PWORKSPACEDATA->optionsValid = false;
+                    } else {
+                        nstackSetOption(NSTACK_OPTIONS[NSTACK_OPTION_MFACT], *PWORKSPACEDATA, wsmfact);
+                        PWORKSPACEDATA->overrides |= nstackOptionBit(NSTACK_OPTION_MFACT);
+                    }
+                    batch.monitors.insert(PWINDOW->monitorID());
+                } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutmsg togglemfact format error: {}", e.what()); }
             }
+            break;
         }
-    } else if (command.starts_with("order")) {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        if (!PWORKSPACEDATA)
-            return 0;
-        if (command == "orderrow")
-            PWORKSPACEDATA->order = NSTACK_ORDER_ROW;
-        else if (command == "ordercolumn")
-            PWORKSPACEDATA->order = NSTACK_ORDER_COLUMN;
-        else if (command == "orderrrow")
-            PWORKSPACEDATA->order = NSTACK_ORDER_RROW;
-        else if (command == "orderrcolumn")
-            PWORKSPACEDATA->order = NSTACK_ORDER_RCOLUMN;
-        else if (command == "ordernext")
-            PWORKSPACEDATA->order = (eColOrder)(((int)PWORKSPACEDATA->order + 1) % 4);
-        else if (command == "orderprev")
-            PWORKSPACEDATA->order = (eColOrder)(((int)PWORKSPACEDATA->order + 3) % 4);
-
-        PWORKSPACEDATA->overrides.emplace("order");
-        recalculateMonitor(PWINDOW->monitorID());
-        refreshWindows(PWINDOW);
-    } else if (command == "mfact") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        if (!PWORKSPACEDATA)
-            return 0;
-        if (vars.size() >= 2) {
-            try {
-                auto wsmfact                  = std::stof(vars[1]);
-                PWORKSPACEDATA->master_factor = wsmfact;
-                PWORKSPACEDATA->overrides.emplace("mfact");
-                recalculateMonitor(PWINDOW->monitorID());
-            } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutmsg mfact format error: {}", e.what()); }
-        } else {
-            PWORKSPACEDATA->overrides.erase("mfact");
-            recalculateMonitor(PWINDOW->monitorID());
+        // set <option> <value>, any layout option for the current workspace until resetoverrides
+        case NSTACK_CMD_SET: {
+            const auto PWINDOW = header.pWindow;
+            if (!PWINDOW)
+                return;
+            const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
+            if (!PWORKSPACEDATA)
+                return;
+
+            const auto OPTION = vars.size() >= 3 ? nstackFindOption(vars[1]) : nullptr;
+            if (!OPTION) {
+                Debug::log(ERR, "Nstack layoutmsg set needs an option and a value");
+                break;
+            }
+            if (!setOptionFromString(*OPTION, *PWORKSPACEDATA, vars.join(" ", 2))) {
+                Debug::log(ERR, "Nstack layoutmsg set: invalid value for {}: {}", vars[1], vars.join(" ", 2));
+                break;
+            }
+
+            PWORKSPACEDATA->overrides |= nstackOptionBit(OPTION->option);
+            batch.monitors.insert(PWINDOW->monitorID());
+            batch.refreshWindow = PWINDOW;
+            break;
         }
-    } else if (command == "togglemfact") {
-        const auto PWINDOW = header.pWindow;
-        if (!PWINDOW)
-            return 0;
-        const auto PWORKSPACEDATA = getMasterWorkspaceData(PWINDOW->workspaceID());
-        if (!PWORKSPACEDATA)
-            return 0;
-        if (vars.size() >= 2) {
-            try {
-                auto wsmfact = std::stof(vars[1]);
-                if (PWORKSPACEDATA->master_factor == wsmfact) {
-                    PWORKSPACEDATA->master_factor = 0;
-                    PWORKSPACEDATA->overrides.erase("mfact");
-                } else {
-                    PWORKSPACEDATA->master_factor = wsmfact;
-                    PWORKSPACEDATA->overrides.emplace("mfact");
-                }
-                recalculateMonitor(PWINDOW->monitorID());
-            } catch (std::exception& e) { Debug::log(ERR, "Nstack layoutmsg togglemfact format error: {}", e.what()); }
+        // trace <on | off | toggle>
+        case NSTACK_CMD_TRACE: {
+            const bool ENABLE = vars.size() < 2 || vars[1] == "toggle" ? !g_nstackTrace.enabled() : vars[1] == "on";
+            g_nstackTrace.setEnabled(ENABLE);
+            Debug::log(LOG, "nstack: tracing {}", ENABLE ? "enabled" : "disabled");
+            break;
+        }
+        // tracedump <path>, writes the trace buffer as chrome trace-event json
+        case NSTACK_CMD_TRACEDUMP: {
+            if (vars.size() < 2) {
+                Debug::log(ERR, "Nstack layoutmsg tracedump needs a path");
+                break;
+            }
+            const auto PATH  = vars.join(" ", 1);
+            const auto COUNT = g_nstackTrace.dumpChromeJson(PATH);
+            if (COUNT < 0)
+                Debug::log(ERR, "Nstack layoutmsg tracedump: can't write {}", PATH);
+            else
+                Debug::log(LOG, "nstack: wrote {} trace spans to {}", COUNT, PATH);
+            break;
+        }
+        // record <path | off>, see nstackRecord.hpp
+        case NSTACK_CMD_RECORD: {
+            if (vars.size() < 2) {
+                Debug::log(ERR, "Nstack layoutmsg record needs a path or off");
+                break;
+            }
+            if (vars[1] == "off") {
+                const auto EVENTS = m_cRecorder.events();
+                m_cRecorder.stop();
+                Debug::log(LOG, "nstack: recording stopped after {} events", EVENTS);
+            } else
+                startRecording(vars.join(" ", 1));
+            break;
         }
+        case NSTACK_CMD_INVALID: Debug::log(ERR, "Nstack layoutmsg unknown command: {}", vars[0]); break;
     }
-
-    return 0;
 }
 
 // If vars is null, we use the default list
@@ -1454,7 +2055,6 @@ void CHyprNstackLayout::runOrientationCycle(SLayoutMessageHeader& header, CVarLi
         nextOrPrev = cycle.size() + (nextOrPrev % (int)cycle.size());
 
     PWORKSPACEDATA->orientation = cycle.at(nextOrPrev);
-    recalculateMonitor(header.pWindow->monitorID());
 }
 
 void CHyprNstackLayout::buildOrientationCycleVectorFromEOperation(std::vector<eColOrientation>& cycle) {
@@ -1485,7 +2085,10 @@ void CHyprNstackLayout::moveWindowTo(PHLWINDOW pWindow, const std::string& dir,
     if (!isDirection(dir))
         return;
 
-    const auto PWINDOW2 = g_pCompositor->getWindowInDirection(pWindow, dir[0]);
+    // the neighbouring tile, only past the edge of the workspace the compositor looks further
+    auto PWINDOW2 = getWindowInDirection(pWindow, nstackParseDirection(dir.substr(0, 1)));
+    if (!PWINDOW2)
+        PWINDOW2 = g_pCompositor->getWindowInDirection(pWindow, dir[0]);
 
     if (!PWINDOW2)
         return;
@@ -1516,25 +2119,341 @@ void CHyprNstackLayout::replaceWindowDataWith(PHLWINDOW from, PHLWINDOW to) {
     if (!PNODE)
         return;
 
+    m_mWindowNodes[to.get()] = m_mWindowNodes[from.get()];
+    m_mWindowNodes.erase(from.get());
     PNODE->pWindow = to;
 
     applyNodeDataToWindow(PNODE);
 }
 
 void CHyprNstackLayout::onEnable() {
+    loadSnapshot();
+
+    // build the node sets of every workspace first, without laying anything out
+    m_bAdopting = true;
     for (auto& w : g_pCompositor->m_windows) {
         if (w->m_isFloating || !w->m_isMapped || w->isHidden())
             continue;
 
         onWindowCreatedTiling(w);
     }
+    m_bAdopting = false;
+
+    // then each visible workspace once. Hidden ones aren't left until they are shown: their
+    // geometry is computed on the idle armed below (precomputeHiddenWorkspaces), without applying
+    // anything, and the nodes stay dirty so showing the workspace only applies their boxes
+    std::vector<MONITORID> monitors;
+    for (auto& m : g_pCompositor->m_monitors) {
+        if (m->m_activeSpecialWorkspace)
+            getMasterWorkspaceData(m->m_activeSpecialWorkspace->m_id)->fullRelayout = true;
+        if (m->m_activeWorkspace)
+            getMasterWorkspaceData(m->m_activeWorkspace->m_id)->fullRelayout = true;
+        monitors.push_back(m->m_id);
+    }
+    relayoutMonitors(monitors);
+
+    // runs onRelayoutIdle, which precomputes the hidden workspaces adopted above
+    if (!m_pRelayoutIdle)
+        m_pRelayoutIdle = wl_event_loop_add_idle(g_pCompositor->m_wlEventLoop, &CHyprNstackLayout::onRelayoutIdle, this);
 }
 
 void CHyprNstackLayout::onDisable() {
-    m_lMasterNodesData.clear();
+    // write the final state while the nodes are still around
+    if (m_pSnapshotTimer) {
+        wl_event_source_remove(m_pSnapshotTimer);
+        m_pSnapshotTimer = nullptr;
+    }
+    saveSnapshot();
+    m_mSnapshotWorkspaces.clear();
+    m_mSnapshotWindows.clear();
+
+    m_cNodes.clear();
+    m_mWindowNodes.clear();
+    m_mWorkspaceNodes.clear();
+    m_sPendingResizeMonitors.clear();
+    m_sPendingRelayouts.clear();
+    m_cShapeCache.clear();
+    m_cRecorder.stop();
+
+    if (m_pRelayoutIdle) {
+        wl_event_source_remove(m_pRelayoutIdle);
+        m_pRelayoutIdle = nullptr;
+    }
+}
+
+std::string CHyprNstackLayout::statsReport(bool json) {
+    std::string out;
+    const auto& RELAYOUTS = m_sRelayoutStats;
+    const auto  SHAPES    = m_cShapeCache.stats();
+    const auto& MEMO      = m_sMemoStats;
+
+    if (json) {
+        out = std::format(R"#({{"operations": {}, "relayouts": {{"requested": {}, "merged": {}, "skipped": {}, "run": {}, "suspended": {}}}, )#", g_nstackStats.format(true),
+                          RELAYOUTS.requested, RELAYOUTS.merged, RELAYOUTS.skipped, RELAYOUTS.flushed, RELAYOUTS.suspended);
+        out += std::format(R"#("shapeCache": {{"hits": {}, "misses": {}, "uncacheable": {}}}, "skippedWindowUpdates": {}, "warpedWindows": {}, )#", SHAPES.hits, SHAPES.misses,
+                           SHAPES.uncacheable, m_iSkippedWindowUpdates, m_iWarpedWindows);
+        out += std::format(R"#("memo": {{"hits": {}, "misses": {}, "precomputed": {}}}, "workspaces": [)#", MEMO.hits, MEMO.misses, MEMO.precomputed);
+        bool first = true;
+        for (const auto& [id, data] : m_mMasterWorkspacesData) {
+            out += std::format(R"#({}{{"id": {}, "windows": {}, "geometryChanges": {{)#", first ? "" : ", ", id, getNodesOnWorkspace(id));
+            for (size_t op = 0; op < NSTACK_STAT_COUNT; ++op)
+                out += std::format(R"#({}"{}": {})#", op ? ", " : "", NSTACK_STAT_NAMES[op], data.geometryChanges[op]);
+            out += "}}";
+            first = false;
+        }
+        out += "]}";
+        return out;
+    }
+
+    out = g_nstackStats.format(false);
+    out += std::format("relayouts: requested {}, merged {}, skipped {}, run {}, suspended under fullscreen {}\n", RELAYOUTS.requested, RELAYOUTS.merged, RELAYOUTS.skipped,
+                       RELAYOUTS.flushed, RELAYOUTS.suspended);
+    out += std::format("shape cache: hits {}, misses {}, uncacheable {}\n", SHAPES.hits, SHAPES.misses, SHAPES.uncacheable);
+    out += std::format("window updates skipped (nothing changed): {}\n", m_iSkippedWindowUpdates);
+    out += std::format("windows warped over max_animated_windows: {}\n", m_iWarpedWindows);
+    out += std::format("memoized layouts: hits {}, misses {}, precomputed while hidden {}\n", MEMO.hits, MEMO.misses, MEMO.precomputed);
+    for (const auto& [id, data] : m_mMasterWorkspacesData) {
+        out += std::format("workspace {} ({} windows): geometry changes", id, getNodesOnWorkspace(id));
+        for (size_t op = 0; op < NSTACK_STAT_COUNT; ++op)
+            out += std::format(" {} {}", NSTACK_STAT_NAMES[op], data.geometryChanges[op]);
+        out += "\n";
+    }
+
+    return out;
+}
+
+void CHyprNstackLayout::resetStats() {
+    g_nstackStats.reset();
+    m_sRelayoutStats = {};
+    m_sMemoStats     = {};
+    m_cShapeCache.resetStats();
+    m_iSkippedWindowUpdates = 0;
+    m_iWarpedWindows        = 0;
+    for (auto& [id, data] : m_mMasterWorkspacesData)
+        data.geometryChanges = {};
+}
+
+static constexpr int SNAPSHOT_DEBOUNCE_MS = 1000;
+
+// the snapshot keeps its own flags so the file format doesn't follow eNstackOption
+static constexpr std::pair<eNstackSnapshotOverride, eNstackOption> SNAPSHOT_OVERRIDES[] = {
+    {NSTACK_SNAPSHOT_OVERRIDE_ORIENTATION, NSTACK_OPTION_ORIENTATION},
+    {NSTACK_SNAPSHOT_OVERRIDE_ORDER, NSTACK_OPTION_ORDER},
+    {NSTACK_SNAPSHOT_OVERRIDE_STACKS, NSTACK_OPTION_STACKS},
+    {NSTACK_SNAPSHOT_OVERRIDE_MFACT, NSTACK_OPTION_MFACT},
+};
+
+static std::string snapshotWindowKey(const std::string& workspace, const std::string& windowClass, const std::string& initialTitle) {
+    return workspace + '\n' + windowClass + '\n' + initialTitle;
+}
+
+void CHyprNstackLayout::loadSnapshot() {
+    m_mSnapshotWorkspaces.clear();
+    m_mSnapshotWindows.clear();
+
+    SNstackSnapshot snapshot;
+    if (!nstackReadSnapshot(nstackSnapshotPath(), snapshot))
+        return;
+
+    for (auto& ws : snapshot.workspaces)
+        m_mSnapshotWorkspaces[ws.name] = std::move(ws);
+
+    for (auto& w : snapshot.windows) {
+        const auto KEY = snapshotWindowKey(w.workspace, w.windowClass, w.initialTitle);
+        m_mSnapshotWindows[KEY].push_back(std::move(w));
+    }
+
+    Debug::log(LOG, "nstack: loaded snapshot with {} workspaces, {} windows", m_mSnapshotWorkspaces.size(), snapshot.windows.size());
+}
+
+void CHyprNstackLayout::saveSnapshot() {
+    SNstackSnapshot snapshot;
+
+    for (const auto& [id, wsNodes] : m_mWorkspaceNodes) {
+        const auto PWORKSPACE = g_pCompositor->getWorkspaceByID(id);
+        if (!PWORKSPACE)
+            continue;
+
+        if (const auto DATAIT = m_mMasterWorkspacesData.find(id); DATAIT != m_mMasterWorkspacesData.end()) {
+            const auto& DATA = DATAIT->second;
+            auto&       ws   = snapshot.workspaces.emplace_back();
+            ws.name          = PWORKSPACE->m_name;
+            ws.stackCount    = DATA.m_iStackCount;
+            ws.orientation   = DATA.orientation;
+            ws.order         = DATA.order;
+            ws.masterFactor  = DATA.master_factor;
+            ws.stackPercs    = DATA.stackPercs;
+            for (const auto& [flag, option] : SNAPSHOT_OVERRIDES) {
+                if (DATA.overrides & nstackOptionBit(option))
+                    ws.overrides |= flag;
+            }
+        }
+
+        for (const auto& n : getWorkspaceNodes(id)) {
+            const auto PWINDOW = n->pWindow.lock();
+            if (!PWINDOW)
+                continue;
+
+            auto& w        = snapshot.windows.emplace_back();
+            w.workspace    = PWORKSPACE->m_name;
+            w.windowClass  = PWINDOW->m_initialClass;
+            w.initialTitle = PWINDOW->m_initialTitle;
+            w.flags        = (n->isMaster ? NSTACK_SNAPSHOT_WINDOW_MASTER : 0) | (n->masterAdjusted ? NSTACK_SNAPSHOT_WINDOW_MASTER_ADJUSTED : 0);
+            w.percMaster   = n->percMaster;
+            w.percSize     = n->percSize;
+        }
+    }
+
+    // records whose windows haven't come back yet are kept for later
+    for (const auto& [name, ws] : m_mSnapshotWorkspaces)
+        snapshot.workspaces.push_back(ws);
+    for (const auto& [key, windows] : m_mSnapshotWindows)
+        snapshot.windows.insert(snapshot.windows.end(), windows.begin(), windows.end());
+
+    if (!nstackWriteSnapshot(nstackSnapshotPath(), snapshot))
+        Debug::log(ERR, "nstack: failed to write the layout snapshot to {}", nstackSnapshotPath());
+}
+
+void CHyprNstackLayout::scheduleSnapshotSave() {
+    if (!m_pSnapshotTimer)
+        m_pSnapshotTimer = wl_event_loop_add_timer(g_pCompositor->m_wlEventLoop, &CHyprNstackLayout::onSnapshotTimer, this);
+
+    // every change pushes the write back, so a drag is only written once it settles
+    if (m_pSnapshotTimer)
+        wl_event_source_timer_update(m_pSnapshotTimer, SNAPSHOT_DEBOUNCE_MS);
+}
+
+int CHyprNstackLayout::onSnapshotTimer(void* data) {
+    ((CHyprNstackLayout*)data)->saveSnapshot();
+    return 0;
+}
+
+void CHyprNstackLayout::restoreWorkspaceSnapshot(SNstackWorkspaceData* wsData, PHLWORKSPACE pWorkspace) {
+    if (!pWorkspace)
+        return;
+
+    const auto IT = m_mSnapshotWorkspaces.find(pWorkspace->m_name);
+    if (IT == m_mSnapshotWorkspaces.end())
+        return;
+
+    const auto& SNAPSHOT = IT->second;
+
+    for (const auto& [flag, option] : SNAPSHOT_OVERRIDES) {
+        if (SNAPSHOT.overrides & flag)
+            wsData->overrides |= nstackOptionBit(option);
+    }
+
+    wsData->orientation   = (eColOrientation)SNAPSHOT.orientation;
+    wsData->order         = (eColOrder)SNAPSHOT.order;
+    wsData->m_iStackCount = SNAPSHOT.stackCount;
+    wsData->master_factor = SNAPSHOT.masterFactor;
+    wsData->stackPercs    = SNAPSHOT.stackPercs;
+
+    m_mSnapshotWorkspaces.erase(IT);
+}
+
+std::optional<SNstackSnapshotWindow> CHyprNstackLayout::takeWindowSnapshot(PHLWINDOW pWindow) {
+    if (m_mSnapshotWindows.empty() || !pWindow->m_workspace)
+        return std::nullopt;
+
+    const auto IT = m_mSnapshotWindows.find(snapshotWindowKey(pWindow->m_workspace->m_name, pWindow->m_initialClass, pWindow->m_initialTitle));
+    if (IT == m_mSnapshotWindows.end())
+        return std::nullopt;
+
+    auto snapshot = std::move(IT->second.front());
+    IT->second.pop_front();
+    if (IT->second.empty())
+        m_mSnapshotWindows.erase(IT);
+
+    return snapshot;
 }
 
+void CHyprNstackLayout::restoreNodeSnapshot(SNstackNodeData* pNode, const SNstackSnapshotWindow& snapshot) {
+    const bool MASTER = snapshot.flags & NSTACK_SNAPSHOT_WINDOW_MASTER;
+
+    // masters that only hold the spot until the restored ones come back step down
+    if (MASTER) {
+        for (const auto& nd : getWorkspaceNodes(pNode->workspaceID)) {
+            if (nd != pNode && nd->isMaster && !nd->restoredMaster)
+                setNodeMaster(nd, false);
+        }
+    }
+
+    // a workspace always needs a master
+    setNodeMaster(pNode, MASTER || getMastersOnWorkspace(pNode->workspaceID) == 0);
+    pNode->restoredMaster = MASTER;
+    pNode->percMaster     = snapshot.percMaster;
+    pNode->masterAdjusted = snapshot.flags & NSTACK_SNAPSHOT_WINDOW_MASTER_ADJUSTED;
+    pNode->percSize       = snapshot.percSize;
+    touchWorkspaceNodes(pNode->workspaceID);
+}
+
+// size the next window would get, so its first configure already matches.
+// Mirrors onWindowCreatedTiling on a copy of the workspace; snapshot restores and oversized windows aren't predicted
 Vector2D CHyprNstackLayout::predictSizeForNewWindowTiled() {
-    //What the fuck is this shit. Seriously.
-    return {};
+    const auto PMONITOR = g_pCompositor->m_lastMonitor.lock();
+
+    if (!PMONITOR)
+        return {};
+
+    const auto PWORKSPACE = PMONITOR->m_activeSpecialWorkspace ? PMONITOR->m_activeSpecialWorkspace : PMONITOR->m_activeWorkspace;
+
+    if (!PWORKSPACE || PWORKSPACE->m_hasFullscreenWindow)
+        return {};
+
+    const auto      PWORKSPACEDATA = getMasterWorkspaceData(PWORKSPACE->m_id);
+    const int       WINDOWS        = getNodesOnWorkspace(PWORKSPACE->m_id) + 1;
+
+    SNstackGeometry geom;
+    geom.monitorPosition     = toNstackVec(PMONITOR->m_position);
+    geom.monitorSize         = toNstackVec(PMONITOR->m_size);
+    geom.reservedTopLeft     = toNstackVec(PMONITOR->m_reservedTopLeft);
+    geom.reservedBottomRight = toNstackVec(PMONITOR->m_reservedBottomRight);
+    geom.options             = geometryOptions(PWORKSPACEDATA);
+    geom.stackPercs          = PWORKSPACEDATA->stackPercs;
+    geom.stackNodeCount      = PWORKSPACEDATA->stackNodeCount;
+
+    geom.nodes.reserve(WINDOWS);
+    for (const auto& n : getWorkspaceNodes(PWORKSPACE->m_id)) {
+        auto& gn          = geom.nodes.emplace_back();
+        gn.isMaster       = n->isMaster;
+        gn.masterAdjusted = n->masterAdjusted;
+        gn.percMaster     = n->percMaster;
+        gn.percSize       = n->percSize;
+        gn.stackNum       = n->stackNum;
+    }
+
+    const size_t NEWINDEX = PWORKSPACEDATA->new_on_top ? 0 : geom.nodes.size();
+    auto&        newNode  = *geom.nodes.emplace(geom.nodes.begin() + NEWINDEX);
+    const bool   PROMOTED = PWORKSPACEDATA->auto_promote > 1 && WINDOWS == PWORKSPACEDATA->auto_promote;
+
+    if (PWORKSPACEDATA->new_is_master || WINDOWS == 1 || PROMOTED) {
+        for (auto& gn : geom.nodes) {
+            if (&gn != &newNode && gn.isMaster) {
+                gn.isMaster            = PROMOTED;
+                newNode.percMaster     = gn.percMaster;
+                newNode.masterAdjusted = gn.masterAdjusted;
+                break;
+            }
+        }
+        newNode.isMaster = true;
+    }
+
+    if (!nstackComputeGeometry(geom))
+        return {};
+
+    if (PWORKSPACEDATA->no_gaps_when_only && WINDOWS == 1 && !g_pCompositor->isWorkspaceSpecial(PWORKSPACE->m_id))
+        return toVector2D(newNode.size);
+
+    // a new window has no decorations yet, so nothing reserved
+    SNstackBoxes boxes;
+    boxes.resize(1);
+    boxes.x[0] = newNode.position.x;
+    boxes.y[0] = newNode.position.y;
+    boxes.w[0] = newNode.size.x;
+    boxes.h[0] = newNode.size.y;
+
+    nstackApplyGaps(boxes, gapOptions(PWORKSPACE, PMONITOR));
+
+    return CBox{boxes.x[0], boxes.y[0], boxes.w[0], boxes.h[0]}.round().size();
 }
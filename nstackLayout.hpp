@@ -1,6 +1,16 @@
 #pragma once
 
 #include "globals.hpp"
+#include "nstackGeometry.hpp"
+#include "nstackCommands.hpp"
+#include "nstackOptions.hpp"
+#include "nstackRecord.hpp"
+#include "nstackShapeCache.hpp"
+#include "nstackSlab.hpp"
+#include "nstackSnapshot.hpp"
+#include "nstackSpatialIndex.hpp"
+#include "nstackStats.hpp"
+#include "nstackTrace.hpp"
 #include <hyprland/src/desktop/DesktopTypes.hpp>
 #include <hyprland/src/layout/IHyprLayout.hpp>
 #include <hyprland/src/config/ConfigManager.hpp>
@@ -9,80 +19,157 @@
 #include <hyprland/src/managers/input/InputManager.hpp>
 #include <hyprland/src/managers/LayoutManager.hpp>
 #include <vector>
-#include <list>
 #include <deque>
+#include <unordered_map>
 #include <any>
 
 enum eFullscreenMode : int8_t;
 
-//orientation determines which side of the screen the master area resides
-enum eColOrientation : uint8_t {
-    NSTACK_ORIENTATION_LEFT = 0,
-    NSTACK_ORIENTATION_TOP,
-    NSTACK_ORIENTATION_RIGHT,
-    NSTACK_ORIENTATION_BOTTOM,
-    NSTACK_ORIENTATION_HCENTER,
-    NSTACK_ORIENTATION_VCENTER,
-};
+// what applyNodeGeometry last gave a window
+struct SNstackAppliedState {
+    bool     valid = false;
+    Vector2D position; // m_realPosition / m_realSize goals
+    Vector2D size;
+    bool     noGaps   = false; // no_gaps_when_only overrides set
+    bool     noBorder = false;
+    bool     decorate = true;
 
-// order determines how slave windows are filled in
-// e.g. if orientation is left, order would be:
-// ROW:     COLUMN:  RROW:    RCOLUMN:
-// 123      135      321      531
-// 456      246      654      642
-enum eColOrder : uint8_t {
-    NSTACK_ORDER_ROW = 0, // rows first (default)
-    NSTACK_ORDER_COLUMN,  // columns first
-    NSTACK_ORDER_RROW,    // rows first, mirrored
-    NSTACK_ORDER_RCOLUMN, // columns first, mirrored
+    bool     operator==(const SNstackAppliedState&) const = default;
 };
 
 struct SNstackNodeData {
-    bool         isMaster       = false;
-    bool         masterAdjusted = false;
-    float        percMaster     = 0.5f;
-    int          stackNum       = 0;
+    bool                isMaster       = false;
+    bool                masterAdjusted = false;
+    float               percMaster     = 0.5f;
+    int                 stackNum       = 0;
+
+    PHLWINDOWREF        pWindow;
 
-    PHLWINDOWREF pWindow;
+    Vector2D            position;
+    Vector2D            size;
 
-    Vector2D     position;
-    Vector2D     size;
+    float               percSize = 1.f; // size multiplier for resizing children
 
-    float        percSize = 1.f; // size multiplier for resizing children
+    int                 workspaceID            = -1;
+    bool                ignoreFullscreenChecks = false;
+    bool                dirty                  = true;  // window needs reapplying even if the box didn't change
+    int                 kindIndex              = -1;    // position among the masters or slaves of its workspace
+    int                 tileIndex              = -1;    // into its workspace's spatial index
+    bool                restoredMaster         = false; // was a master in the restored snapshot
+    int                 boxIndex               = -1;    // into its workspace's SNstackBoxes while a pass applies it
+    SNstackAppliedState applied;                        // skip reapplying when nothing would change
+    SNstackHandle       handle;                         // its slot in m_cNodes
+    bool                warp = false;                   // over max_animated_windows, placed without animating
+};
 
-    int          workspaceID            = -1;
-    bool         ignoreFullscreenChecks = false;
+// While the inputs a workspace was laid out from still match, its nodes already hold the boxes a
+// new pass would compute, and showing the workspace only has to apply them
+struct SNstackGeometryMemo {
+    bool                   valid      = false;
+    uint64_t               generation = 0; // SNstackWorkspaceNodes::generation
+    SNstackVec             monitorPosition;
+    SNstackVec             monitorSize;
+    SNstackVec             reservedTopLeft;
+    SNstackVec             reservedBottomRight;
+    SNstackGeometryOptions options;
 
-    bool         operator==(const SNstackNodeData& rhs) const {
-        return pWindow.lock() == rhs.pWindow.lock();
-    }
+    bool                   operator==(const SNstackGeometryMemo&) const = default;
 };
 
-struct SNstackWorkspaceData {
+// what a workspace rule can match on: the w[...] window and group counts, the f[...] fullscreen
+// state and the workspace name
+struct SNstackRuleKey {
+    int         tiled          = -1;
+    int         windows        = -1;
+    int         visible        = -1;
+    int         groups         = -1;
+    int         fullscreenMode = -1;
+    std::string name;
+
+    bool        operator==(const SNstackRuleKey&) const = default;
+};
+
+// the layout options live in SNstackOptions, see nstackOptions.hpp
+struct SNstackWorkspaceData : SNstackOptions {
     int                   workspaceID = -1;
     std::vector<float>    stackPercs;
     std::vector<int>      stackNodeCount;
-    int                   m_iStackCount        = 2;
-    bool                  new_on_top           = false;
-    bool                  new_is_master        = true;
-    bool                  center_single_master = false;
-    bool                  inherit_fullscreen   = true;
-    int                   no_gaps_when_only    = 0;
-    float                 master_factor        = 0.0f;
-    float                 single_master_factor = 0.5f;
-    float                 x_factor             = 0.0f;
-    float                 special_scale_factor = 0.8f;
-    eColOrientation       orientation          = NSTACK_ORIENTATION_LEFT;
-    eColOrder             order                = NSTACK_ORDER_ROW;
-    int                   auto_promote         = 0;
-    int                   auto_demote          = 0;
-    std::set<std::string> overrides;
+    // options set by layoutmsg, kept when the config or rule is reapplied
+    NstackOptionMask      overrides = 0;
+
+    // resolved workspace rule and the state it was resolved against
+    SWorkspaceRule        rule;
+    bool                  optionsValid = false;
+    SNstackRuleKey        optionsKey;
+
+    // reapply every node on the next pass, not only the ones that moved or are dirty
+    bool                  fullRelayout = true;
+    // a window just left fullscreen: the recalculateMonitor Hyprland follows that with only needs
+    // the nodes that moved or are dirty, so it doesn't set fullRelayout. Cleared by the next pass
+    bool                  fullscreenExited = false;
+    // nodes that got a new box since their windows were last applied, checked against max_animated_windows
+    int                   movedNodes = 0;
+
+    // inputs the nodes' boxes were last computed from, see SNstackGeometryMemo
+    SNstackGeometryMemo   geometryMemo;
+
+    // stand-in node keeping a maximized window on its box while the tiles underneath are left alone
+    SNstackNodeData       fullscreenNode;
+
+    // windows whose box changed, by the operation that caused it
+    std::array<uint64_t, NSTACK_STAT_COUNT> geometryChanges{};
 
     bool                  operator==(const SNstackWorkspaceData& rhs) const {
         return workspaceID == rhs.workspaceID;
     }
 };
 
+// Per-workspace index over m_cNodes. Nodes are kept in layout order
+// (masters and slaves interleaved, same relative order the global list used to have).
+// Everything here holds handles, resolved through m_cNodes when used
+struct SNstackWorkspaceNodes {
+    std::vector<SNstackHandle> nodes;
+    int                        masters = 0;
+
+    // masters and slaves split out of nodes for cycling, rebuilt lazily
+    std::vector<SNstackHandle> masterNodes;
+    std::vector<SNstackHandle> slaveNodes;
+    bool                       kindsValid = false;
+
+    // bumped whenever a node is added, removed, promoted or resized
+    uint64_t                   generation = 0;
+
+    // window boxes of the pass being applied
+    SNstackBoxes               boxes;
+
+    // directional neighbours over the nodes' boxes, rebuilt lazily after they moved
+    CNstackSpatialIndex        spatial;
+    std::vector<SNstackHandle> spatialNodes; // node of every tile in spatial
+    bool                       spatialValid = false;
+};
+
+// counters for the deferred relayout scheduler
+struct SNstackRelayoutStats {
+    uint64_t requested = 0; // deferred relayouts asked for
+    uint64_t merged    = 0; // asked for a monitor that was already pending
+    uint64_t skipped   = 0; // pending, but a direct recalculation of the monitor got there first
+    uint64_t flushed   = 0; // relayouts actually run when the pending set was flushed
+    uint64_t suspended = 0; // workspace passes that only kept a fullscreen window in place
+};
+
+// layouts reused instead of recomputed
+struct SNstackMemoStats {
+    uint64_t hits        = 0; // passes that only applied boxes computed earlier
+    uint64_t misses      = 0; // passes that had to compute the workspace
+    uint64_t precomputed = 0; // hidden workspaces laid out during idle time
+};
+
+// layout work requested by one layoutmsg (or a whole batch), done once after all commands ran
+struct SNstackMessageBatch {
+    std::set<MONITORID> monitors;
+    PHLWINDOW           refreshWindow;
+};
+
 class CHyprNstackLayout : public IHyprLayout {
   public:
     virtual void                     onWindowCreatedTiling(PHLWINDOW, eDirection direction = DIRECTION_DEFAULT);
@@ -104,27 +191,96 @@ class CHyprNstackLayout : public IHyprLayout {
     virtual void                     onEnable();
     virtual void                     onDisable();
     void                             removeWorkspaceData(const int& ws);
+    void                             invalidateWorkspaceOptions();
+    void                             onPreRender(PHLMONITOR);
+    void                             scheduleRecalculateMonitor(const MONITORID&);
+    void                             flushPendingRelayouts();
+    std::string                      statsReport(bool json);
+    void                             resetStats();
 
   private:
-    std::list<SNstackNodeData>      m_lMasterNodesData;
-    std::list<SNstackWorkspaceData> m_lMasterWorkspacesData;
-
-    bool                            m_bForceWarps = false;
-
-    void                            buildOrientationCycleVectorFromVars(std::vector<eColOrientation>& cycle, CVarList& vars);
-    void                            buildOrientationCycleVectorFromEOperation(std::vector<eColOrientation>& cycle);
-    void                            runOrientationCycle(SLayoutMessageHeader& header, CVarList* vars, int next);
-    int                             getNodesOnWorkspace(const int&);
-    void                            applyNodeDataToWindow(SNstackNodeData*);
-    void                            resetNodeSplits(const int&);
-    SNstackNodeData*                getNodeFromWindow(PHLWINDOW);
-    SNstackNodeData*                getMasterNodeOnWorkspace(const int&);
-    SNstackWorkspaceData*           getMasterWorkspaceData(const int&);
-    void                            calculateWorkspace(PHLWORKSPACE);
-    PHLWINDOW                       getNextWindow(PHLWINDOW, bool);
-    int                             getMastersOnWorkspace(const int&);
-    bool                            prepareLoseFocus(PHLWINDOW);
-    void                            prepareNewFocus(PHLWINDOW, bool inherit_fullscreen);
+    CNstackSlab<SNstackNodeData>                                       m_cNodes;
+    std::unordered_map<CWindow*, SNstackHandle>                        m_mWindowNodes;
+    std::unordered_map<int, SNstackWorkspaceNodes>                     m_mWorkspaceNodes;
+    std::unordered_map<int, SNstackWorkspaceData>                      m_mMasterWorkspacesData;
+
+    std::set<MONITORID>                                                m_sPendingResizeMonitors;
+    std::set<MONITORID>                                                m_sPendingRelayouts;
+    wl_event_source*                                                   m_pRelayoutIdle = nullptr;
+    SNstackRelayoutStats                                               m_sRelayoutStats;
+    SNstackMemoStats                                                   m_sMemoStats;
+    uint64_t                                                           m_iNodeGeneration = 0;
+    CNstackShapeCache                                                  m_cShapeCache;
+    CNstackRecorder                                                    m_cRecorder;
+    uint64_t                                                           m_iSkippedWindowUpdates = 0;
+    uint64_t                                                           m_iWarpedWindows        = 0;
+
+    bool                                                               m_bForceWarps = false;
+    bool                                                               m_bAdopting   = false;
+    eNstackStatOp                                                      m_eStatOp     = NSTACK_STAT_CALCULATE_WORKSPACE; // what geometry changes are counted towards
+
+    // snapshot records not matched to a workspace / window yet, and the debounced writer
+    std::unordered_map<std::string, SNstackSnapshotWorkspace>          m_mSnapshotWorkspaces;
+    std::unordered_map<std::string, std::deque<SNstackSnapshotWindow>> m_mSnapshotWindows;
+    wl_event_source*                                                   m_pSnapshotTimer = nullptr;
+
+    SNstackNodeData*                                                   addNode(PHLWINDOW, const int& ws, bool front);
+    void                                                               removeNode(PHLWINDOW);
+    void                                                               setNodeMaster(SNstackNodeData*, bool);
+    void                                                               touchWorkspaceNodes(const int& ws);
+    void                                                               swapNodeWindows(SNstackNodeData*, SNstackNodeData*);
+    const std::vector<SNstackHandle>&                                  getWorkspaceHandles(const int&);
+    auto                                                               getWorkspaceNodes(const int&);
+    SNstackNodeData*                                                   getNode(const SNstackHandle&);
+
+    void                                                               buildOrientationCycleVectorFromVars(std::vector<eColOrientation>& cycle, CVarList& vars);
+    void                                                               buildOrientationCycleVectorFromEOperation(std::vector<eColOrientation>& cycle);
+    void                                                               runOrientationCycle(SLayoutMessageHeader& header, CVarList* vars, int next);
+    void                                                               runLayoutMessage(SLayoutMessageHeader& header, CVarList& vars, SNstackMessageBatch& batch);
+    void                                                               switchToWindow(SLayoutMessageHeader& header, PHLWINDOW);
+    void                                                               refreshWindows(SLayoutMessageHeader& header, PHLWINDOW);
+    int                                                                getNodesOnWorkspace(const int&);
+    void                                                               applyNodeDataToWindow(SNstackNodeData*);
+    void                                                               applyNodeGeometry(SNstackNodeData*);
+    SNstackGapOptions                                                  gapOptions(PHLWORKSPACE, PHLMONITOR);
+    void                                                               prepareWindowBoxes(PHLWORKSPACE, bool full);
+    void                                                               markWarpedNodes(const int& ws);
+    bool                                                               windowBoxFromPass(SNstackNodeData*, int boxIndex, const SBoxExtents& reserved, CBox& box);
+    CBox                                                               windowBox(SNstackNodeData*, PHLMONITOR, int boxIndex, const SBoxExtents& reserved);
+    void                                                               resetNodeSplits(const int&);
+    SNstackNodeData*                                                   getNodeFromWindow(PHLWINDOW);
+    SNstackNodeData*                                                   getMasterNodeOnWorkspace(const int&);
+    SNstackWorkspaceData*                                              getMasterWorkspaceData(const int&);
+    void                                                               relayoutMonitor(const MONITORID&);
+    void                                                               relayoutMonitors(const std::vector<MONITORID>&);
+    void                                                               scheduleRelayout(const MONITORID&);
+    void                                                               precomputeHiddenWorkspaces();
+    static void                                                        onRelayoutIdle(void*);
+
+    void                                                               loadSnapshot();
+    void                                                               saveSnapshot();
+    void                                                               scheduleSnapshotSave();
+    static int                                                         onSnapshotTimer(void*);
+    void                                                               restoreWorkspaceSnapshot(SNstackWorkspaceData*, PHLWORKSPACE);
+    std::optional<SNstackSnapshotWindow>                               takeWindowSnapshot(PHLWINDOW);
+    void                                                               restoreNodeSnapshot(SNstackNodeData*, const SNstackSnapshotWindow&);
+    void                                                               startRecording(const std::string& path);
+    void                                                               recordMonitor(PHLMONITOR);
+    void                                                               recordWorkspace(PHLWORKSPACE, PHLMONITOR);
+    void                                                               recordWindowRemoved(PHLWINDOW);
+    void                                                               calculateWorkspace(PHLWORKSPACE);
+    bool                                                               prepareWorkspaceGeometry(PHLWORKSPACE, SNstackGeometry&);
+    void                                                               fillGeometryFrame(PHLWORKSPACE, PHLMONITOR, SNstackGeometry&);
+    void                                                               fillGeometryNodes(PHLWORKSPACE, SNstackGeometry&);
+    bool                                                               geometryMemoMatches(PHLWORKSPACE, const SNstackGeometry&);
+    bool                                                               storeWorkspaceGeometry(PHLWORKSPACE, SNstackGeometry&, bool laidOut, bool visible);
+    void                                                               applyWorkspaceGeometry(PHLWORKSPACE, SNstackGeometry&, bool laidOut);
+    void                                                               applyWorkspaceWindows(PHLWORKSPACE);
+    PHLWINDOW                                                          getNextWindow(PHLWINDOW, bool);
+    PHLWINDOW                                                          getWindowInDirection(PHLWINDOW, eNstackDirection);
+    int                                                                getMastersOnWorkspace(const int&);
+    bool                                                               prepareLoseFocus(PHLWINDOW);
+    void                                                               prepareNewFocus(PHLWINDOW, bool inherit_fullscreen);
 
     friend struct SNstackNodeData;
     friend struct SNstackWorkspaceData;
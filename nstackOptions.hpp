@@ -0,0 +1,189 @@
+#pragma once
+
+// Layout options.
+// NSTACK_OPTIONS describes every option once: PLUGIN_INIT registers plugin:nstack:layout:<name>
+// from it, workspace rules are read from layoutopt nstack-<name> through it, and an option set by
+// layoutmsg is one bit in SNstackWorkspaceData::overrides. Adding an option is a field in
+// SNstackOptions and a row in the table. Its bounds are enforced whichever way the value is set.
+// Like nstackCommands.hpp this is resolved at compile time and doesn't depend on Hyprland.
+
+#include "nstackGeometry.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <string_view>
+#include <variant>
+
+// resolved per workspace (config value, then workspace rule, then layoutmsg overrides)
+struct SNstackOptions {
+    float           master_factor        = 0.0f;
+    float           single_master_factor = 0.5f;
+    float           x_factor             = 0.0f;
+    float           special_scale_factor = 0.8f;
+    int             m_iStackCount        = 2;
+    int             no_gaps_when_only    = 0;
+    int             auto_promote         = 0;
+    int             auto_demote          = 0;
+    int             max_animated_windows = 0;
+    eColOrientation orientation          = NSTACK_ORIENTATION_LEFT;
+    eColOrder       order                = NSTACK_ORDER_ROW;
+    bool            new_on_top           = false;
+    bool            new_is_master        = true;
+    bool            center_single_master = false;
+    bool            inherit_fullscreen   = true;
+};
+
+enum eNstackOption : uint8_t {
+    NSTACK_OPTION_ORIENTATION = 0,
+    NSTACK_OPTION_NEW_ON_TOP,
+    NSTACK_OPTION_NEW_IS_MASTER,
+    NSTACK_OPTION_NO_GAPS_WHEN_ONLY,
+    NSTACK_OPTION_SPECIAL_SCALE_FACTOR,
+    NSTACK_OPTION_INHERIT_FULLSCREEN,
+    NSTACK_OPTION_STACKS,
+    NSTACK_OPTION_CENTER_SINGLE_MASTER,
+    NSTACK_OPTION_MFACT,
+    NSTACK_OPTION_SINGLE_MFACT,
+    NSTACK_OPTION_XFACT,
+    NSTACK_OPTION_AUTO_PROMOTE,
+    NSTACK_OPTION_AUTO_DEMOTE,
+    NSTACK_OPTION_ORDER,
+    NSTACK_OPTION_MAX_ANIMATED_WINDOWS,
+    NSTACK_OPTION_COUNT,
+};
+
+// a bit per option
+using NstackOptionMask = uint16_t;
+static_assert(NSTACK_OPTION_COUNT <= sizeof(NstackOptionMask) * 8);
+
+constexpr NstackOptionMask nstackOptionBit(eNstackOption option) {
+    return NstackOptionMask(1) << option;
+}
+
+// config type follows the field: bool and int are INT, float is FLOAT, orientation and order are STRING
+using NstackOptionField = std::variant<bool SNstackOptions::*, int SNstackOptions::*, float SNstackOptions::*, eColOrientation SNstackOptions::*, eColOrder SNstackOptions::*>;
+
+enum eNstackOptionConfigType : uint8_t {
+    NSTACK_OPTION_CONFIG_INT = 0,
+    NSTACK_OPTION_CONFIG_FLOAT,
+    NSTACK_OPTION_CONFIG_STRING,
+};
+
+struct SNstackOption {
+    eNstackOption     option;
+    std::string_view  name;
+    NstackOptionField field;
+    float             defaultValue  = 0; // bool, int and float options
+    std::string_view  defaultString = {}; // orientation and order
+    bool              zeroKeeps     = false; // 0 leaves the value alone instead of setting it
+    double            minValue      = std::numeric_limits<double>::lowest(); // bool, int and float values are clamped to these
+    double            maxValue      = std::numeric_limits<double>::max();
+
+    constexpr eNstackOptionConfigType configType() const {
+        switch (field.index()) {
+            case 0:
+            case 1: return NSTACK_OPTION_CONFIG_INT;
+            case 2: return NSTACK_OPTION_CONFIG_FLOAT;
+            default: return NSTACK_OPTION_CONFIG_STRING;
+        }
+    }
+};
+
+inline constexpr std::string_view NSTACK_OPTION_CONFIG_PREFIX = "plugin:nstack:layout:";
+inline constexpr std::string_view NSTACK_OPTION_RULE_PREFIX   = "nstack-";
+
+inline constexpr SNstackOption    NSTACK_OPTIONS[] = {
+    {NSTACK_OPTION_ORIENTATION, "orientation", &SNstackOptions::orientation, 0, "left"},
+    {NSTACK_OPTION_NEW_ON_TOP, "new_on_top", &SNstackOptions::new_on_top, 0},
+    {NSTACK_OPTION_NEW_IS_MASTER, "new_is_master", &SNstackOptions::new_is_master, 1},
+    {NSTACK_OPTION_NO_GAPS_WHEN_ONLY, "no_gaps_when_only", &SNstackOptions::no_gaps_when_only, 0},
+    {NSTACK_OPTION_SPECIAL_SCALE_FACTOR, "special_scale_factor", &SNstackOptions::special_scale_factor, 0.8f, {}, false, 0, 1},
+    {NSTACK_OPTION_INHERIT_FULLSCREEN, "inherit_fullscreen", &SNstackOptions::inherit_fullscreen, 1},
+    {NSTACK_OPTION_STACKS, "stacks", &SNstackOptions::m_iStackCount, 2, {}, true, 2},
+    {NSTACK_OPTION_CENTER_SINGLE_MASTER, "center_single_master", &SNstackOptions::center_single_master, 0},
+    {NSTACK_OPTION_MFACT, "mfact", &SNstackOptions::master_factor, 0.5f, {}, false, 0, 1},
+    {NSTACK_OPTION_SINGLE_MFACT, "single_mfact", &SNstackOptions::single_master_factor, 0.5f, {}, false, 0, 1},
+    {NSTACK_OPTION_XFACT, "xfact", &SNstackOptions::x_factor, 0.0f, {}, false, 0, 1},
+    {NSTACK_OPTION_AUTO_PROMOTE, "auto_promote", &SNstackOptions::auto_promote, 0},
+    {NSTACK_OPTION_AUTO_DEMOTE, "auto_demote", &SNstackOptions::auto_demote, 1},
+    {NSTACK_OPTION_ORDER, "order", &SNstackOptions::order, 0, "row"},
+    {NSTACK_OPTION_MAX_ANIMATED_WINDOWS, "max_animated_windows", &SNstackOptions::max_animated_windows, 0},
+};
+
+constexpr bool nstackOptionTableIsConsistent() {
+    if (std::size(NSTACK_OPTIONS) != NSTACK_OPTION_COUNT)
+        return false;
+
+    for (size_t i = 0; i < std::size(NSTACK_OPTIONS); ++i) {
+        if (NSTACK_OPTIONS[i].option != i || (NSTACK_OPTIONS[i].configType() == NSTACK_OPTION_CONFIG_STRING) == NSTACK_OPTIONS[i].defaultString.empty())
+            return false;
+        if (NSTACK_OPTIONS[i].defaultValue < NSTACK_OPTIONS[i].minValue || NSTACK_OPTIONS[i].defaultValue > NSTACK_OPTIONS[i].maxValue)
+            return false;
+        for (size_t j = 0; j < i; ++j) {
+            if (NSTACK_OPTIONS[i].name == NSTACK_OPTIONS[j].name)
+                return false;
+        }
+    }
+    return true;
+}
+static_assert(nstackOptionTableIsConsistent(), "NSTACK_OPTIONS must list every option once, in eNstackOption order, with defaults in bounds");
+
+constexpr const SNstackOption* nstackFindOption(std::string_view name) {
+    for (const auto& o : NSTACK_OPTIONS) {
+        if (o.name == name)
+            return &o;
+    }
+    return nullptr;
+}
+
+// anything unknown is hcenter, so "center" keeps working
+constexpr eColOrientation nstackParseOrientation(std::string_view str) {
+    if (str == "top")
+        return NSTACK_ORIENTATION_TOP;
+    if (str == "right")
+        return NSTACK_ORIENTATION_RIGHT;
+    if (str == "bottom")
+        return NSTACK_ORIENTATION_BOTTOM;
+    if (str == "left")
+        return NSTACK_ORIENTATION_LEFT;
+    if (str == "vcenter")
+        return NSTACK_ORIENTATION_VCENTER;
+    return NSTACK_ORIENTATION_HCENTER;
+}
+
+// prefixes, so "column" and "c" are the same
+constexpr eColOrder nstackParseOrder(std::string_view str) {
+    if (str.starts_with("rr"))
+        return NSTACK_ORDER_RROW;
+    if (str.starts_with("rc"))
+        return NSTACK_ORDER_RCOLUMN;
+    if (str.starts_with("c"))
+        return NSTACK_ORDER_COLUMN;
+    return NSTACK_ORDER_ROW;
+}
+
+// stores a bool, int or float option, clamped to its bounds (fewer than 2 stacks or a factor
+// outside [0, 1] breaks the geometry). Orientation and order go through nstackSetOptionString
+constexpr void nstackSetOption(const SNstackOption& option, SNstackOptions& options, double value) {
+    // NaN
+    if (value != value || (option.zeroKeeps && value == 0))
+        return;
+
+    value = std::clamp(value, option.minValue, option.maxValue);
+
+    switch (option.field.index()) {
+        case 0: options.*std::get<0>(option.field) = value != 0; break;
+        case 1: options.*std::get<1>(option.field) = (int)std::clamp<double>(value, std::numeric_limits<int>::min(), std::numeric_limits<int>::max()); break;
+        case 2: options.*std::get<2>(option.field) = (float)value; break;
+        default: break;
+    }
+}
+
+constexpr void nstackSetOptionString(const SNstackOption& option, SNstackOptions& options, std::string_view value) {
+    switch (option.field.index()) {
+        case 3: options.*std::get<3>(option.field) = nstackParseOrientation(value); break;
+        case 4: options.*std::get<4>(option.field) = nstackParseOrder(value); break;
+        default: break;
+    }
+}
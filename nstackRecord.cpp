@@ -0,0 +1,299 @@
+#include "nstackRecord.hpp"
+#include <chrono>
+#include <cstring>
+
+// the recorder buffers this much before handing it to stdio
+static constexpr size_t RECORD_FLUSH_BYTES = 64 * 1024;
+
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+template <typename T>
+static void put(std::vector<char>& out, const T& value) {
+    const auto OFFSET = out.size();
+    out.resize(OFFSET + sizeof(T));
+    memcpy(out.data() + OFFSET, &value, sizeof(T));
+}
+
+static void putString(std::vector<char>& out, const std::string& str) {
+    const uint16_t LEN = std::min<size_t>(str.size(), UINT16_MAX);
+    put(out, LEN);
+    out.insert(out.end(), str.begin(), str.begin() + LEN);
+}
+
+// field by field, the structs have padding
+static void putOptions(std::vector<char>& out, const SNstackGeometryOptions& options) {
+    put(out, (int32_t)options.stackCount);
+    put(out, (uint8_t)options.center_single_master);
+    put(out, options.master_factor);
+    put(out, options.single_master_factor);
+    put(out, options.x_factor);
+    put(out, (uint8_t)options.orientation);
+    put(out, (uint8_t)options.order);
+}
+
+CNstackRecorder::~CNstackRecorder() {
+    stop();
+}
+
+bool CNstackRecorder::start(const std::string& path) {
+    stop();
+
+    m_pFile = fopen(path.c_str(), "wb");
+    if (!m_pFile)
+        return false;
+
+    m_iStartNs    = nowNs();
+    m_iEvents     = 0;
+    m_iNextWindow = 1;
+    put(m_vBuffer, SNstackRecordHeader{});
+    return true;
+}
+
+void CNstackRecorder::stop() {
+    if (!m_pFile)
+        return;
+
+    flush();
+    fclose(m_pFile);
+    m_pFile = nullptr;
+
+    m_mWindows.clear();
+    m_mMonitors.clear();
+    m_mWorkspaces.clear();
+}
+
+void CNstackRecorder::flush() {
+    if (!m_vBuffer.empty())
+        fwrite(m_vBuffer.data(), 1, m_vBuffer.size(), m_pFile);
+    m_vBuffer.clear();
+    fflush(m_pFile);
+}
+
+uint32_t CNstackRecorder::windowID(const void* window) {
+    if (!window)
+        return 0;
+
+    const auto [IT, INSERTED] = m_mWindows.try_emplace(window, m_iNextWindow);
+    if (INSERTED)
+        m_iNextWindow++;
+    return IT->second;
+}
+
+void CNstackRecorder::forgetWindow(const void* window) {
+    m_mWindows.erase(window);
+}
+
+void CNstackRecorder::record(SNstackRecordEvent& event) {
+    if (!m_pFile)
+        return;
+
+    event.timeNs = nowNs() - m_iStartNs;
+
+    auto& out = m_vBuffer;
+    put(out, event.type);
+    put(out, event.timeNs);
+
+    switch (event.type) {
+        case NSTACK_RECORD_MONITOR: {
+            const auto& M = event.monitor;
+            put(out, M.id);
+            put(out, M.position);
+            put(out, M.size);
+            put(out, M.reservedTopLeft);
+            put(out, M.reservedBottomRight);
+            put(out, M.activeWorkspace);
+            put(out, M.activeSpecialWorkspace);
+            break;
+        }
+        case NSTACK_RECORD_WORKSPACE: {
+            const auto& W = event.workspaceData;
+            put(out, W.id);
+            put(out, W.monitor);
+            putOptions(out, W.options);
+            put(out, (uint8_t)W.newOnTop);
+            put(out, (uint8_t)W.newIsMaster);
+            put(out, W.autoPromote);
+            put(out, W.autoDemote);
+            break;
+        }
+        case NSTACK_RECORD_ADOPT:
+            put(out, event.window);
+            put(out, event.workspace);
+            put(out, (uint8_t)event.node.isMaster);
+            put(out, (uint8_t)event.node.masterAdjusted);
+            put(out, event.node.percMaster);
+            put(out, event.node.percSize);
+            break;
+        case NSTACK_RECORD_WINDOW_CREATED:
+            put(out, event.window);
+            put(out, event.workspace);
+            put(out, (int8_t)event.arg);
+            put(out, (uint8_t)event.arg2);
+            break;
+        case NSTACK_RECORD_WINDOW_REMOVED: put(out, event.window); break;
+        case NSTACK_RECORD_RESIZE:
+            put(out, event.window);
+            put(out, event.delta);
+            put(out, (uint8_t)event.arg);
+            break;
+        case NSTACK_RECORD_LAYOUTMSG:
+            put(out, event.window);
+            putString(out, event.message);
+            break;
+        case NSTACK_RECORD_SWITCH_WINDOWS:
+            put(out, event.window);
+            put(out, event.window2);
+            break;
+        case NSTACK_RECORD_FULLSCREEN:
+            put(out, event.window);
+            put(out, (int8_t)event.arg);
+            put(out, (int8_t)event.arg2);
+            break;
+        case NSTACK_RECORD_COUNT: break;
+    }
+
+    m_iEvents++;
+    if (out.size() >= RECORD_FLUSH_BYTES)
+        flush();
+}
+
+void CNstackRecorder::recordMonitor(const SNstackRecordMonitor& monitor) {
+    if (!m_pFile)
+        return;
+
+    const auto [IT, INSERTED] = m_mMonitors.try_emplace(monitor.id, monitor);
+    if (!INSERTED) {
+        if (IT->second == monitor)
+            return;
+        IT->second = monitor;
+    }
+
+    SNstackRecordEvent event;
+    event.type    = NSTACK_RECORD_MONITOR;
+    event.monitor = monitor;
+    record(event);
+}
+
+void CNstackRecorder::recordWorkspace(const SNstackRecordWorkspace& workspace) {
+    if (!m_pFile)
+        return;
+
+    const auto [IT, INSERTED] = m_mWorkspaces.try_emplace(workspace.id, workspace);
+    if (!INSERTED) {
+        if (IT->second == workspace)
+            return;
+        IT->second = workspace;
+    }
+
+    SNstackRecordEvent event;
+    event.type          = NSTACK_RECORD_WORKSPACE;
+    event.workspaceData = workspace;
+    record(event);
+}
+
+// reads plain values back, every read is bounds checked
+class CRecordReader {
+  public:
+    CRecordReader(const std::vector<char>& data) : m_vData(data) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (m_vData.size() - m_iOffset < sizeof(T))
+            return false;
+        memcpy(&value, m_vData.data() + m_iOffset, sizeof(T));
+        m_iOffset += sizeof(T);
+        return true;
+    }
+
+    // reads a narrower on-disk value into a wider (or enum) field
+    template <typename Disk, typename T>
+    bool getAs(T& value) {
+        Disk disk{};
+        if (!get(disk))
+            return false;
+        value = (T)disk;
+        return true;
+    }
+
+    bool getString(std::string& str) {
+        uint16_t len = 0;
+        if (!get(len) || m_vData.size() - m_iOffset < len)
+            return false;
+        str.assign(m_vData.data() + m_iOffset, len);
+        m_iOffset += len;
+        return true;
+    }
+
+    bool getOptions(SNstackGeometryOptions& options) {
+        return getAs<int32_t>(options.stackCount) && getAs<uint8_t>(options.center_single_master) && get(options.master_factor) && get(options.single_master_factor) &&
+            get(options.x_factor) && getAs<uint8_t>(options.orientation) && getAs<uint8_t>(options.order);
+    }
+
+    bool atEnd() const {
+        return m_iOffset == m_vData.size();
+    }
+
+  private:
+    const std::vector<char>& m_vData;
+    size_t                   m_iOffset = 0;
+};
+
+static bool readEvent(CRecordReader& reader, SNstackRecordEvent& event) {
+    if (!reader.get(event.type) || !reader.get(event.timeNs))
+        return false;
+
+    switch (event.type) {
+        case NSTACK_RECORD_MONITOR: {
+            auto& m = event.monitor;
+            return reader.get(m.id) && reader.get(m.position) && reader.get(m.size) && reader.get(m.reservedTopLeft) && reader.get(m.reservedBottomRight) &&
+                reader.get(m.activeWorkspace) && reader.get(m.activeSpecialWorkspace);
+        }
+        case NSTACK_RECORD_WORKSPACE: {
+            auto& w = event.workspaceData;
+            return reader.get(w.id) && reader.get(w.monitor) && reader.getOptions(w.options) && reader.getAs<uint8_t>(w.newOnTop) && reader.getAs<uint8_t>(w.newIsMaster) &&
+                reader.get(w.autoPromote) && reader.get(w.autoDemote);
+        }
+        case NSTACK_RECORD_ADOPT:
+            return reader.get(event.window) && reader.get(event.workspace) && reader.getAs<uint8_t>(event.node.isMaster) && reader.getAs<uint8_t>(event.node.masterAdjusted) &&
+                reader.get(event.node.percMaster) && reader.get(event.node.percSize);
+        case NSTACK_RECORD_WINDOW_CREATED:
+            return reader.get(event.window) && reader.get(event.workspace) && reader.getAs<int8_t>(event.arg) && reader.getAs<uint8_t>(event.arg2);
+        case NSTACK_RECORD_WINDOW_REMOVED: return reader.get(event.window);
+        case NSTACK_RECORD_RESIZE: return reader.get(event.window) && reader.get(event.delta) && reader.getAs<uint8_t>(event.arg);
+        case NSTACK_RECORD_LAYOUTMSG: return reader.get(event.window) && reader.getString(event.message);
+        case NSTACK_RECORD_SWITCH_WINDOWS: return reader.get(event.window) && reader.get(event.window2);
+        case NSTACK_RECORD_FULLSCREEN: return reader.get(event.window) && reader.getAs<int8_t>(event.arg) && reader.getAs<int8_t>(event.arg2);
+        case NSTACK_RECORD_COUNT: break;
+    }
+
+    return false;
+}
+
+bool nstackReadRecording(const std::string& path, std::vector<SNstackRecordEvent>& events) {
+    const auto FILE = fopen(path.c_str(), "rb");
+    if (!FILE)
+        return false;
+
+    std::vector<char> data;
+    char              chunk[RECORD_FLUSH_BYTES];
+    size_t            read = 0;
+    while ((read = fread(chunk, 1, sizeof(chunk), FILE)) > 0)
+        data.insert(data.end(), chunk, chunk + read);
+    fclose(FILE);
+
+    CRecordReader       reader(data);
+    SNstackRecordHeader header;
+    if (!reader.get(header) || header.magic != NSTACK_RECORD_MAGIC || header.version != NSTACK_RECORD_VERSION)
+        return false;
+
+    while (!reader.atEnd()) {
+        SNstackRecordEvent event;
+        if (!readEvent(reader, event))
+            break;
+        events.push_back(std::move(event));
+    }
+
+    return true;
+}
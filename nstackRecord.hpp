@@ -0,0 +1,135 @@
+#pragma once
+
+// Recorder for layout event streams (layoutmsg record <path> | off).
+// Every event that can change the layout is appended to a compact binary file, so a real session
+// can be replayed offline against a headless model of the layout (make replay, bench/replay.cpp).
+// Like nstackGeometry this doesn't depend on Hyprland; windows are identified by small ids handed
+// out per recording.
+//
+// File layout (native endianness, like the snapshot):
+//   SNstackRecordHeader
+//   n x { type u8, timeNs u64, payload depending on the type, see nstackRecord.cpp }
+// A recording cut short (crash, compositor killed) is read up to its last complete event.
+
+#include "nstackGeometry.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+inline constexpr uint32_t NSTACK_RECORD_MAGIC   = 0x4352534e; // "NSRC"
+inline constexpr uint16_t NSTACK_RECORD_VERSION = 1;
+
+enum eNstackRecordEvent : uint8_t {
+    NSTACK_RECORD_MONITOR = 0,    // monitor box, reserved area or shown workspaces changed
+    NSTACK_RECORD_WORKSPACE,      // resolved options of a workspace changed
+    NSTACK_RECORD_ADOPT,          // node that already existed when the recording started
+    NSTACK_RECORD_WINDOW_CREATED, // onWindowCreatedTiling
+    NSTACK_RECORD_WINDOW_REMOVED, // onWindowRemovedTiling
+    NSTACK_RECORD_RESIZE,         // resizeActiveWindow
+    NSTACK_RECORD_LAYOUTMSG,      // layoutMessage
+    NSTACK_RECORD_SWITCH_WINDOWS, // switchWindows
+    NSTACK_RECORD_FULLSCREEN,     // fullscreenRequestForWindow
+    NSTACK_RECORD_COUNT,
+};
+
+inline constexpr const char* NSTACK_RECORD_NAMES[NSTACK_RECORD_COUNT] = {"monitor", "workspace", "adopt", "windowCreated", "windowRemoved", "resize", "layoutmsg",
+                                                                          "switchWindows", "fullscreen"};
+
+// NSTACK_RECORD_WINDOW_CREATED flags, the compositor state the new window's role depends on
+enum eNstackRecordCreateFlags : uint8_t {
+    NSTACK_RECORD_CREATE_FIRST_MAP         = 1 << 0,
+    NSTACK_RECORD_CREATE_OPENING_ON_MASTER = 1 << 1, // the focused tile it opens next to is a master
+};
+
+struct SNstackRecordHeader {
+    uint32_t magic    = NSTACK_RECORD_MAGIC;
+    uint16_t version  = NSTACK_RECORD_VERSION;
+    uint16_t reserved = 0;
+};
+
+struct SNstackRecordMonitor {
+    int64_t    id = -1;
+    SNstackVec position;
+    SNstackVec size;
+    SNstackVec reservedTopLeft;
+    SNstackVec reservedBottomRight;
+    int64_t    activeWorkspace        = -1;
+    int64_t    activeSpecialWorkspace = -1;
+
+    bool       operator==(const SNstackRecordMonitor&) const = default;
+};
+
+struct SNstackRecordWorkspace {
+    int64_t                id      = -1;
+    int64_t                monitor = -1;
+    SNstackGeometryOptions options;
+    bool                   newOnTop    = false;
+    bool                   newIsMaster = true;
+    int32_t                autoPromote = 0;
+    int32_t                autoDemote  = 0;
+
+    bool                   operator==(const SNstackRecordWorkspace&) const = default;
+};
+
+// one recorded event, only the fields of its type are written
+struct SNstackRecordEvent {
+    eNstackRecordEvent     type   = NSTACK_RECORD_MONITOR;
+    uint64_t               timeNs = 0; // since the recording started
+
+    uint32_t               window    = 0; // 0 is no window
+    uint32_t               window2   = 0; // switchWindows
+    int64_t                workspace = -1;
+    int32_t                arg       = 0; // direction, corner or the current fullscreen mode
+    int32_t                arg2      = 0; // create flags or the requested fullscreen mode
+    SNstackVec             delta;         // resize
+    std::string            message;       // layoutmsg
+
+    SNstackRecordMonitor   monitor;
+    SNstackRecordWorkspace workspaceData;
+    SNstackGeometryNode    node; // adopt: isMaster, masterAdjusted, percMaster and percSize
+};
+
+class CNstackRecorder {
+  public:
+    ~CNstackRecorder();
+
+    // truncates path, returns false if it can't be opened
+    bool     start(const std::string& path);
+    void     stop();
+
+    bool     active() const {
+        return m_pFile;
+    }
+
+    uint64_t events() const {
+        return m_iEvents;
+    }
+
+    // id of a window for this recording, handed out on first use
+    uint32_t windowID(const void* window);
+    // after its removal was recorded, the address may be reused by a new window
+    void     forgetWindow(const void* window);
+
+    void     record(SNstackRecordEvent& event);
+
+    // only written when they differ from what was last recorded for the same id
+    void     recordMonitor(const SNstackRecordMonitor& monitor);
+    void     recordWorkspace(const SNstackRecordWorkspace& workspace);
+
+  private:
+    void                                                flush();
+
+    FILE*                                               m_pFile       = nullptr;
+    uint64_t                                            m_iStartNs    = 0;
+    uint64_t                                            m_iEvents     = 0;
+    uint32_t                                            m_iNextWindow = 1;
+    std::vector<char>                                   m_vBuffer;
+    std::unordered_map<const void*, uint32_t>           m_mWindows;
+    std::unordered_map<int64_t, SNstackRecordMonitor>   m_mMonitors;
+    std::unordered_map<int64_t, SNstackRecordWorkspace> m_mWorkspaces;
+};
+
+// reads a whole recording. Returns false on a missing, foreign or outdated file
+bool nstackReadRecording(const std::string& path, std::vector<SNstackRecordEvent>& events);
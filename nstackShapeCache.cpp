@@ -0,0 +1,176 @@
+#include "nstackShapeCache.hpp"
+#include <algorithm>
+
+static SNstackShapeKey shapeKey(const SNstackGeometry& geom) {
+    const auto&     OPTS = geom.options;
+    SNstackShapeKey key;
+    key.nodeCount            = geom.nodes.size();
+    key.masterCount          = std::count_if(geom.nodes.begin(), geom.nodes.end(), [](const auto& n) { return n.isMaster; });
+    key.stackCount           = OPTS.stackCount;
+    key.center_single_master = OPTS.center_single_master;
+    key.master_factor        = OPTS.master_factor;
+    key.single_master_factor = OPTS.single_master_factor;
+    key.x_factor             = OPTS.x_factor;
+    key.orientation          = OPTS.orientation;
+    key.order                = OPTS.order;
+    return key;
+}
+
+// the area every cached box is relative to
+static void usableBox(const SNstackGeometry& geom, SNstackVec& origin, SNstackVec& size) {
+    SNstackVec topLeft, bottomRight;
+    nstackReservedArea(geom, topLeft, bottomRight);
+    origin = geom.monitorPosition + topLeft;
+    size   = geom.monitorSize - topLeft - bottomRight;
+}
+
+// whether the layout is fully determined by the key and scales with the usable box
+static bool isCacheable(const SNstackGeometry& geom, const SNstackShapeKey& key, const SNstackVec& size) {
+    // column orders move on to the next stack once less than 1px is left in one, which only
+    // behaves the same at every scale while every slot is at least a pixel
+    if (!key.masterCount || size.x < key.nodeCount || size.y < key.nodeCount)
+        return false;
+
+    // centered masters are offset by half the monitor, which includes the reserved area. With a bar
+    // on that axis (e.g. vcenter under waybar) the layout never scales, so it is always computed
+    const auto ORIENTATION = key.orientation;
+    const int  SLAVES      = key.nodeCount - key.masterCount;
+    int        centerAxis  = -1;
+    if (!SLAVES && key.center_single_master)
+        centerAxis = ORIENTATION == NSTACK_ORIENTATION_TOP || ORIENTATION == NSTACK_ORIENTATION_BOTTOM;
+    else if (SLAVES >= 2 && ORIENTATION == NSTACK_ORIENTATION_HCENTER)
+        centerAxis = 0;
+    else if (SLAVES >= 2 && ORIENTATION == NSTACK_ORIENTATION_VCENTER)
+        centerAxis = 1;
+
+    if (centerAxis == 0 && geom.reservedTopLeft.x + geom.reservedBottomRight.x != 0)
+        return false;
+    if (centerAxis == 1 && geom.reservedTopLeft.y + geom.reservedBottomRight.y != 0)
+        return false;
+
+    // checked last, it's the only part that walks the nodes
+    bool firstMaster = true;
+    for (const auto& n : geom.nodes) {
+        if (n.percSize != 1.f)
+            return false;
+        if (n.isMaster && firstMaster) {
+            if (n.masterAdjusted)
+                return false;
+            firstMaster = false;
+        }
+    }
+
+    if (std::any_of(geom.stackPercs.begin(), geom.stackPercs.end(), [](float p) { return p != 1.f; }))
+        return false;
+
+    return true;
+}
+
+static bool slaveStacksMatch(const SNstackGeometry& geom, const std::vector<int>& stacks) {
+    size_t slave = 0;
+    for (const auto& n : geom.nodes) {
+        if (!n.isMaster && n.stackNum != stacks[slave++])
+            return false;
+    }
+    return true;
+}
+
+CNstackShapeCache::CNstackShapeCache(size_t capacity) : m_iCapacity(capacity) {
+    m_vShapes.reserve(capacity);
+}
+
+bool CNstackShapeCache::compute(SNstackGeometry& geom) {
+    const auto KEY = shapeKey(geom);
+    SNstackVec origin, size;
+    usableBox(geom, origin, size);
+
+    if (!isCacheable(geom, KEY, size)) {
+        m_sStats.uncacheable++;
+        return nstackComputeGeometry(geom);
+    }
+
+    // column orders also read the stack every slave was in last time
+    const bool COLUMNS = KEY.order % 2;
+
+    const auto IT = std::find_if(m_vShapes.begin(), m_vShapes.end(), [&](const auto& s) { return s.key == KEY && (!COLUMNS || slaveStacksMatch(geom, s.slaveStacks)); });
+
+    if (IT != m_vShapes.end()) {
+        m_sStats.hits++;
+        IT->lastUsed = ++m_iTick;
+
+        size_t master = 0, slave = 0;
+        for (auto& n : geom.nodes) {
+            const auto& RECT = n.isMaster ? IT->masters[master++] : IT->slaves[slave];
+            n.position       = origin + SNstackVec(RECT.position.x * size.x, RECT.position.y * size.y);
+            n.size           = SNstackVec(RECT.size.x * size.x, RECT.size.y * size.y);
+            if (!n.isMaster)
+                n.stackNum = IT->slaveStacks[slave++];
+        }
+
+        std::find_if(geom.nodes.begin(), geom.nodes.end(), [](const auto& n) { return n.isMaster; })->percMaster = IT->percMaster;
+
+        if (!IT->stackNodeCount.empty()) {
+            geom.stackNodeCount = IT->stackNodeCount;
+            geom.stackPercs.resize(IT->stackNodeCount.size(), 1.0f);
+        }
+
+        return true;
+    }
+
+    m_sStats.misses++;
+
+    std::vector<int> inputStacks;
+    if (COLUMNS) {
+        for (const auto& n : geom.nodes) {
+            if (!n.isMaster)
+                inputStacks.push_back(n.stackNum);
+        }
+    }
+
+    if (!nstackComputeGeometry(geom))
+        return false;
+
+    SNstackShape shape;
+    shape.key = KEY;
+    shape.masters.reserve(KEY.masterCount);
+    shape.slaves.reserve(KEY.nodeCount - KEY.masterCount);
+    shape.slaveStacks.reserve(KEY.nodeCount - KEY.masterCount);
+
+    for (const auto& n : geom.nodes) {
+        const auto POS  = n.position - origin;
+        auto&      rect = n.isMaster ? shape.masters.emplace_back() : shape.slaves.emplace_back();
+        rect.position   = SNstackVec(POS.x / size.x, POS.y / size.y);
+        rect.size       = SNstackVec(n.size.x / size.x, n.size.y / size.y);
+        if (!n.isMaster)
+            shape.slaveStacks.push_back(n.stackNum);
+        else if (shape.masters.size() == 1)
+            shape.percMaster = n.percMaster;
+    }
+
+    if (!shape.slaves.empty())
+        shape.stackNodeCount = geom.stackNodeCount;
+
+    // only a layout that reproduces its own input stacks can be replayed for column orders
+    if (COLUMNS && inputStacks != shape.slaveStacks)
+        return true;
+
+    if (m_vShapes.size() >= m_iCapacity)
+        m_vShapes.erase(std::min_element(m_vShapes.begin(), m_vShapes.end(), [](const auto& a, const auto& b) { return a.lastUsed < b.lastUsed; }));
+
+    shape.lastUsed = ++m_iTick;
+    m_vShapes.push_back(std::move(shape));
+
+    return true;
+}
+
+void CNstackShapeCache::clear() {
+    m_vShapes.clear();
+}
+
+SNstackShapeCacheStats CNstackShapeCache::stats() {
+    return m_sStats;
+}
+
+void CNstackShapeCache::resetStats() {
+    m_sStats = {};
+}
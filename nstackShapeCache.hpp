@@ -0,0 +1,65 @@
+#pragma once
+
+// Cache of normalized layouts.
+// Without manual splits a workspace's layout only depends on its node count, master count and
+// options, and scales with the usable monitor area. Those layouts are stored relative to the
+// usable box, so laying out a covered workspace is a scale-and-offset per node.
+// Like nstackGeometry.hpp this must not depend on Hyprland.
+
+#include "nstackGeometry.hpp"
+
+// box relative to the usable area, 0..1
+struct SNstackShapeRect {
+    SNstackVec position;
+    SNstackVec size;
+};
+
+struct SNstackShapeKey {
+    int             nodeCount            = 0;
+    int             masterCount          = 0;
+    int             stackCount           = 0;
+    bool            center_single_master = false;
+    float           master_factor        = 0.0f;
+    float           single_master_factor = 0.0f;
+    float           x_factor             = 0.0f;
+    eColOrientation orientation          = NSTACK_ORIENTATION_LEFT;
+    eColOrder       order                = NSTACK_ORDER_ROW;
+
+    bool            operator==(const SNstackShapeKey&) const = default;
+};
+
+struct SNstackShape {
+    SNstackShapeKey               key;
+    uint64_t                      lastUsed   = 0;
+    float                         percMaster = 0.5f;
+
+    std::vector<SNstackShapeRect> masters;
+    std::vector<SNstackShapeRect> slaves;
+    std::vector<int>              slaveStacks;    // stackNum of every slave, column orders also take it as input
+    std::vector<int>              stackNodeCount; // empty if there are no slaves
+};
+
+struct SNstackShapeCacheStats {
+    uint64_t hits        = 0;
+    uint64_t misses      = 0;
+    uint64_t uncacheable = 0; // manual splits or a state the key doesn't cover
+};
+
+// bounded LRU
+class CNstackShapeCache {
+  public:
+    explicit CNstackShapeCache(size_t capacity = 32);
+
+    // same contract as nstackComputeGeometry, served from the cache whenever the key covers geom
+    bool                   compute(SNstackGeometry& geom);
+
+    void                   clear();
+    SNstackShapeCacheStats stats();
+    void                   resetStats();
+
+  private:
+    size_t                    m_iCapacity;
+    uint64_t                  m_iTick = 0;
+    std::vector<SNstackShape> m_vShapes;
+    SNstackShapeCacheStats    m_sStats;
+};
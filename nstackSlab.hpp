@@ -0,0 +1,107 @@
+#pragma once
+
+// Slab for the layout's nodes.
+// Slots live in fixed-size chunks that never move, so a node keeps its address while it exists,
+// and a freed slot is reused before the slab grows. A handle is a slot index plus the slot's
+// generation, which every erase bumps: a handle kept past its node's removal resolves to nullptr
+// instead of to whichever node took the slot over.
+// Like nstackGeometry this doesn't depend on Hyprland.
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+struct SNstackHandle {
+    uint32_t index      = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool     operator==(const SNstackHandle&) const = default;
+};
+
+template <typename T, size_t CHUNK = 64>
+class CNstackSlab {
+  public:
+    template <typename... Args>
+    std::pair<SNstackHandle, T*> emplace(Args&&... args) {
+        uint32_t index = 0;
+        if (!m_vFree.empty()) {
+            index = m_vFree.back();
+            m_vFree.pop_back();
+        } else {
+            index = m_iSlots++;
+            if (index % CHUNK == 0)
+                m_vChunks.emplace_back(std::make_unique<SSlot[]>(CHUNK));
+        }
+
+        auto& slot = slotAt(index);
+        slot.value.emplace(std::forward<Args>(args)...);
+        m_iSize++;
+        return {{index, slot.generation}, &*slot.value};
+    }
+
+    // false for a stale handle
+    bool erase(const SNstackHandle& handle) {
+        if (!get(handle))
+            return false;
+
+        auto& slot = slotAt(handle.index);
+        slot.value.reset();
+        slot.generation++;
+        m_vFree.push_back(handle.index);
+        m_iSize--;
+        return true;
+    }
+
+    // nullptr once the node is gone, even if its slot is in use again
+    T* get(const SNstackHandle& handle) {
+        if (handle.index >= m_iSlots)
+            return nullptr;
+
+        auto& slot = slotAt(handle.index);
+        return slot.generation == handle.generation && slot.value ? &*slot.value : nullptr;
+    }
+
+    // in slot order
+    template <typename F>
+    void forEach(F&& fn) {
+        for (uint32_t i = 0; i < m_iSlots; ++i) {
+            if (auto& slot = slotAt(i); slot.value)
+                fn(*slot.value);
+        }
+    }
+
+    size_t size() const {
+        return m_iSize;
+    }
+
+    // keeps the chunks, so handles from before stay stale
+    void clear() {
+        m_vFree.clear();
+        for (uint32_t i = m_iSlots; i-- > 0;) {
+            auto& slot = slotAt(i);
+            if (slot.value) {
+                slot.value.reset();
+                slot.generation++;
+            }
+            m_vFree.push_back(i);
+        }
+        m_iSize = 0;
+    }
+
+  private:
+    struct SSlot {
+        std::optional<T> value;
+        uint32_t         generation = 0;
+    };
+
+    SSlot& slotAt(uint32_t index) {
+        return m_vChunks[index / CHUNK][index % CHUNK];
+    }
+
+    std::vector<std::unique_ptr<SSlot[]>> m_vChunks;
+    std::vector<uint32_t>                 m_vFree; // lowest index at the back after a clear
+    uint32_t                              m_iSlots = 0;
+    size_t                                m_iSize  = 0;
+};
@@ -0,0 +1,204 @@
+#include "nstackSnapshot.hpp"
+#include "nstackGeometry.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// the file is trusted no further than the ranges the layout itself keeps these in
+static float clampRatio(float value, float min, float max, float fallback) {
+    return std::isfinite(value) ? std::clamp(value, min, max) : fallback;
+}
+
+// a workspace the geometry can't lay out is dropped, the rest of the file still loads
+static bool sanitizeWorkspace(SNstackSnapshotWorkspace& ws) {
+    if (ws.orientation > NSTACK_ORIENTATION_VCENTER || ws.order > NSTACK_ORDER_RCOLUMN || ws.stackCount < 2)
+        return false;
+
+    // 0 is "split evenly", anything else is a ratio like alterSplitRatio leaves it
+    if (ws.masterFactor != 0.0f)
+        ws.masterFactor = clampRatio(ws.masterFactor, 0.05f, 0.95f, 0.0f);
+    for (auto& perc : ws.stackPercs)
+        perc = clampRatio(perc, 0.05f, 1.95f, 1.0f);
+    return true;
+}
+
+static void sanitizeWindow(SNstackSnapshotWindow& w) {
+    w.percMaster = clampRatio(w.percMaster, 0.05f, 0.95f, 0.5f);
+    w.percSize   = clampRatio(w.percSize, 0.05f, 1.95f, 1.0f);
+}
+
+std::string nstackSnapshotPath() {
+    std::string base;
+    if (const auto XDG = getenv("XDG_STATE_HOME"); XDG && *XDG)
+        base = XDG;
+    else if (const auto HOME = getenv("HOME"); HOME && *HOME)
+        base = std::string(HOME) + "/.local/state";
+    else
+        return "";
+
+    return base + "/hyprnstack/snapshot.bin";
+}
+
+// appends plain values to the output buffer
+class CSnapshotWriter {
+  public:
+    template <typename T>
+    void put(const T& value) {
+        const auto OFFSET = m_vData.size();
+        m_vData.resize(OFFSET + sizeof(T));
+        memcpy(m_vData.data() + OFFSET, &value, sizeof(T));
+    }
+
+    void putString(const std::string& str) {
+        const uint16_t LEN = std::min<size_t>(str.size(), UINT16_MAX);
+        put(LEN);
+        m_vData.insert(m_vData.end(), str.begin(), str.begin() + LEN);
+    }
+
+    const std::vector<char>& data() const {
+        return m_vData;
+    }
+
+  private:
+    std::vector<char> m_vData;
+};
+
+// reads plain values back, every read is bounds checked
+class CSnapshotReader {
+  public:
+    CSnapshotReader(const char* data, size_t size) : m_pData(data), m_iSize(size) {}
+
+    template <typename T>
+    bool get(T& value) {
+        if (m_iSize - m_iOffset < sizeof(T))
+            return false;
+        memcpy(&value, m_pData + m_iOffset, sizeof(T));
+        m_iOffset += sizeof(T);
+        return true;
+    }
+
+    bool getString(std::string& str) {
+        uint16_t len = 0;
+        if (!get(len) || m_iSize - m_iOffset < len)
+            return false;
+        str.assign(m_pData + m_iOffset, len);
+        m_iOffset += len;
+        return true;
+    }
+
+  private:
+    const char* m_pData   = nullptr;
+    size_t      m_iSize   = 0;
+    size_t      m_iOffset = 0;
+};
+
+bool nstackWriteSnapshot(const std::string& path, const SNstackSnapshot& snapshot) {
+    if (path.empty())
+        return false;
+
+    CSnapshotWriter       writer;
+    SNstackSnapshotHeader header;
+    header.workspaceCount = snapshot.workspaces.size();
+    header.windowCount    = snapshot.windows.size();
+    writer.put(header);
+
+    for (const auto& ws : snapshot.workspaces) {
+        writer.putString(ws.name);
+        writer.put(ws.stackCount);
+        writer.put(ws.orientation);
+        writer.put(ws.order);
+        writer.put(ws.overrides);
+        writer.put(ws.masterFactor);
+        writer.put((uint32_t)ws.stackPercs.size());
+        for (const auto& p : ws.stackPercs)
+            writer.put(p);
+    }
+
+    for (const auto& w : snapshot.windows) {
+        writer.putString(w.workspace);
+        writer.putString(w.windowClass);
+        writer.putString(w.initialTitle);
+        writer.put(w.flags);
+        writer.put(w.percMaster);
+        writer.put(w.percSize);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), ec);
+
+    const auto TMPPATH = path + ".tmp";
+    const auto FILE    = fopen(TMPPATH.c_str(), "wb");
+    if (!FILE)
+        return false;
+
+    const auto& DATA    = writer.data();
+    const bool  WRITTEN = fwrite(DATA.data(), 1, DATA.size(), FILE) == DATA.size();
+
+    if (fclose(FILE) != 0 || !WRITTEN) {
+        unlink(TMPPATH.c_str());
+        return false;
+    }
+
+    return rename(TMPPATH.c_str(), path.c_str()) == 0;
+}
+
+bool nstackReadSnapshot(const std::string& path, SNstackSnapshot& snapshot) {
+    if (path.empty())
+        return false;
+
+    const int FD = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (FD < 0)
+        return false;
+
+    struct stat st;
+    if (fstat(FD, &st) != 0 || st.st_size < (off_t)sizeof(SNstackSnapshotHeader)) {
+        close(FD);
+        return false;
+    }
+
+    const size_t SIZE = st.st_size;
+    void*        map  = mmap(nullptr, SIZE, PROT_READ, MAP_PRIVATE, FD, 0);
+    close(FD);
+
+    if (map == MAP_FAILED)
+        return false;
+
+    CSnapshotReader       reader((const char*)map, SIZE);
+    SNstackSnapshotHeader header;
+    SNstackSnapshot       result;
+    bool                  ok = reader.get(header) && header.magic == NSTACK_SNAPSHOT_MAGIC && header.version == NSTACK_SNAPSHOT_VERSION;
+
+    for (uint32_t i = 0; ok && i < header.workspaceCount; ++i) {
+        auto&    ws        = result.workspaces.emplace_back();
+        uint32_t percCount = 0;
+        ok = reader.getString(ws.name) && reader.get(ws.stackCount) && reader.get(ws.orientation) && reader.get(ws.order) && reader.get(ws.overrides) &&
+            reader.get(ws.masterFactor) && reader.get(percCount);
+
+        for (uint32_t p = 0; ok && p < percCount; ++p)
+            ok = reader.get(ws.stackPercs.emplace_back());
+
+        if (ok && !sanitizeWorkspace(ws))
+            result.workspaces.pop_back();
+    }
+
+    for (uint32_t i = 0; ok && i < header.windowCount; ++i) {
+        auto& w = result.windows.emplace_back();
+        ok      = reader.getString(w.workspace) && reader.getString(w.windowClass) && reader.getString(w.initialTitle) && reader.get(w.flags) && reader.get(w.percMaster) &&
+            reader.get(w.percSize);
+        sanitizeWindow(w);
+    }
+
+    munmap(map, SIZE);
+
+    if (ok)
+        snapshot = std::move(result);
+
+    return ok;
+}
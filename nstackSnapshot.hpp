@@ -0,0 +1,73 @@
+#pragma once
+
+// Layout state that survives compositor restarts and plugin reloads.
+// Like nstackGeometry this doesn't depend on Hyprland; the layout converts to and from these structs.
+//
+// File layout (native endianness, the file never leaves the machine):
+//   SNstackSnapshotHeader
+//   workspaceCount x { name, stackCount i32, orientation u8, order u8, overrides u8, masterFactor f32, percCount u32, percCount x f32 }
+//   windowCount    x { workspace name, class, initial title, flags u8, percMaster f32, percSize f32 }
+// strings are a u16 length followed by the bytes.
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+inline constexpr uint32_t NSTACK_SNAPSHOT_MAGIC   = 0x4b54534e; // "NSTK"
+inline constexpr uint16_t NSTACK_SNAPSHOT_VERSION = 1;
+
+// which workspace options were set by layoutmsg and should be restored
+enum eNstackSnapshotOverride : uint8_t {
+    NSTACK_SNAPSHOT_OVERRIDE_ORIENTATION = 1 << 0,
+    NSTACK_SNAPSHOT_OVERRIDE_ORDER       = 1 << 1,
+    NSTACK_SNAPSHOT_OVERRIDE_STACKS      = 1 << 2,
+    NSTACK_SNAPSHOT_OVERRIDE_MFACT       = 1 << 3,
+};
+
+enum eNstackSnapshotWindowFlags : uint8_t {
+    NSTACK_SNAPSHOT_WINDOW_MASTER          = 1 << 0,
+    NSTACK_SNAPSHOT_WINDOW_MASTER_ADJUSTED = 1 << 1,
+};
+
+struct SNstackSnapshotHeader {
+    uint32_t magic          = NSTACK_SNAPSHOT_MAGIC;
+    uint16_t version        = NSTACK_SNAPSHOT_VERSION;
+    uint16_t reserved       = 0;
+    uint32_t workspaceCount = 0;
+    uint32_t windowCount    = 0;
+};
+
+struct SNstackSnapshotWorkspace {
+    std::string        name;
+    int32_t            stackCount   = 2;
+    uint8_t            orientation  = 0;
+    uint8_t            order        = 0;
+    uint8_t            overrides    = 0;
+    float              masterFactor = 0.0f;
+    std::vector<float> stackPercs;
+};
+
+// windows are matched by workspace, class and initial title. Several windows
+// can share a key (e.g. terminals), those are restored in the order they were saved
+struct SNstackSnapshotWindow {
+    std::string workspace;
+    std::string windowClass;
+    std::string initialTitle;
+    uint8_t     flags      = 0;
+    float       percMaster = 0.5f;
+    float       percSize   = 1.f;
+};
+
+struct SNstackSnapshot {
+    std::vector<SNstackSnapshotWorkspace> workspaces;
+    std::vector<SNstackSnapshotWindow>    windows;
+};
+
+// $XDG_STATE_HOME/hyprnstack/snapshot.bin, falling back to ~/.local/state
+std::string nstackSnapshotPath();
+
+// writes to a temporary file next to path and renames it over, so a crash never leaves a torn snapshot
+bool nstackWriteSnapshot(const std::string& path, const SNstackSnapshot& snapshot);
+
+// maps the file and parses it. Returns false on a missing, foreign, outdated or truncated file
+bool nstackReadSnapshot(const std::string& path, SNstackSnapshot& snapshot);
@@ -0,0 +1,74 @@
+#include "nstackSpatialIndex.hpp"
+#include <algorithm>
+#include <map>
+
+eNstackDirection nstackParseDirection(std::string_view str) {
+    if (str == "l" || str == "left")
+        return NSTACK_DIRECTION_LEFT;
+    if (str == "r" || str == "right")
+        return NSTACK_DIRECTION_RIGHT;
+    if (str == "u" || str == "t" || str == "up" || str == "top")
+        return NSTACK_DIRECTION_UP;
+    if (str == "d" || str == "b" || str == "down" || str == "bottom")
+        return NSTACK_DIRECTION_DOWN;
+    return NSTACK_DIRECTION_INVALID;
+}
+
+// position along the stack a tile is in
+double CNstackSpatialIndex::along(uint32_t tile) const {
+    return m_bColumns ? m_vTiles[tile].position.y : m_vTiles[tile].position.x;
+}
+
+double CNstackSpatialIndex::alongEnd(uint32_t tile) const {
+    return along(tile) + (m_bColumns ? m_vTiles[tile].size.y : m_vTiles[tile].size.x);
+}
+
+void CNstackSpatialIndex::build(const std::vector<SNstackSpatialTile>& tiles, bool columns) {
+    m_vTiles   = tiles;
+    m_bColumns = columns;
+    m_vStacks.clear();
+    m_vSlots.assign(tiles.size(), {});
+
+    std::map<int, std::vector<uint32_t>> byStack;
+    for (uint32_t i = 0; i < tiles.size(); ++i)
+        byStack[tiles[i].stack].push_back(i);
+
+    for (auto& [stack, members] : byStack) {
+        auto& s = m_vStacks.emplace_back();
+        std::ranges::sort(members, [this](uint32_t a, uint32_t b) { return along(a) < along(b); });
+        s.tiles = std::move(members);
+        s.start = m_bColumns ? m_vTiles[s.tiles.front()].position.x : m_vTiles[s.tiles.front()].position.y;
+    }
+
+    std::ranges::sort(m_vStacks, {}, &SStack::start);
+
+    for (uint32_t s = 0; s < m_vStacks.size(); ++s) {
+        for (uint32_t row = 0; row < m_vStacks[s].tiles.size(); ++row)
+            m_vSlots[m_vStacks[s].tiles[row]] = {s, row};
+    }
+}
+
+int CNstackSpatialIndex::neighbour(int tile, eNstackDirection direction) const {
+    if (tile < 0 || tile >= (int)m_vSlots.size() || direction == NSTACK_DIRECTION_INVALID)
+        return -1;
+
+    const auto& SLOT    = m_vSlots[tile];
+    const bool  FORWARD = direction == NSTACK_DIRECTION_RIGHT || direction == NSTACK_DIRECTION_DOWN;
+
+    // along the stack: the previous or next row
+    if (m_bColumns == (direction == NSTACK_DIRECTION_UP || direction == NSTACK_DIRECTION_DOWN)) {
+        const auto& ROWS = m_vStacks[SLOT.stack].tiles;
+        const int   ROW  = (int)SLOT.row + (FORWARD ? 1 : -1);
+        return ROW >= 0 && ROW < (int)ROWS.size() ? (int)ROWS[ROW] : -1;
+    }
+
+    // across: the adjacent stack, at the tile covering the middle of this one
+    const int STACK = (int)SLOT.stack + (FORWARD ? 1 : -1);
+    if (STACK < 0 || STACK >= (int)m_vStacks.size())
+        return -1;
+
+    const auto&  ROWS   = m_vStacks[STACK].tiles;
+    const double MIDDLE = (along(tile) + alongEnd(tile)) / 2;
+    const auto   IT     = std::ranges::upper_bound(ROWS, MIDDLE, {}, [this](uint32_t t) { return along(t); });
+    return IT == ROWS.begin() ? (int)ROWS.front() : (int)*(IT - 1);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+// Directional neighbours between the tiles of a workspace (focusdir, swapdir, movewindow).
+// Tiles are grouped by stack, the master area being stack 0. A stack's tiles are sorted along the
+// axis the stack runs, and the stacks along the other axis. A step along a stack goes to the next
+// tile of the same stack. A step across goes to the adjacent stack, to the tile facing the middle
+// of the current one, which is found by binary search.
+// Like nstackGeometry this doesn't depend on Hyprland.
+
+#include "nstackGeometry.hpp"
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+enum eNstackDirection : uint8_t {
+    NSTACK_DIRECTION_LEFT = 0,
+    NSTACK_DIRECTION_RIGHT,
+    NSTACK_DIRECTION_UP,
+    NSTACK_DIRECTION_DOWN,
+    NSTACK_DIRECTION_INVALID,
+};
+
+// l/r/u/d like movefocus, t/b and the spelled out names work too
+eNstackDirection nstackParseDirection(std::string_view str);
+
+struct SNstackSpatialTile {
+    SNstackVec position;
+    SNstackVec size;
+    int        stack = 0; // 0 for masters, SNstackNodeData::stackNum for the rest
+};
+
+class CNstackSpatialIndex {
+  public:
+    // columns: the stacks run top to bottom and sit side by side (left, right and hcenter orientations)
+    void build(const std::vector<SNstackSpatialTile>& tiles, bool columns);
+
+    // index into the tiles build got, -1 at the edge of the workspace
+    int  neighbour(int tile, eNstackDirection direction) const;
+
+  private:
+    struct SStack {
+        double                start = 0; // across the stacks
+        std::vector<uint32_t> tiles;     // sorted along the stack
+    };
+
+    // where a tile sits: its stack and its row in it
+    struct SSlot {
+        uint32_t stack = 0;
+        uint32_t row   = 0;
+    };
+
+    double                          along(uint32_t tile) const;
+    double                          alongEnd(uint32_t tile) const;
+
+    std::vector<SNstackSpatialTile> m_vTiles;
+    std::vector<SStack>             m_vStacks; // sorted by start
+    std::vector<SSlot>              m_vSlots;  // by tile
+    bool                            m_bColumns = true;
+};
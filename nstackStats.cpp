@@ -0,0 +1,67 @@
+#include "nstackStats.hpp"
+#include <cstdio>
+
+void CNstackStats::reset() {
+    for (auto& stats : m_aOps) {
+        stats.calls.store(0, std::memory_order_relaxed);
+        stats.totalNs.store(0, std::memory_order_relaxed);
+        stats.maxNs.store(0, std::memory_order_relaxed);
+        stats.geometryChanges.store(0, std::memory_order_relaxed);
+        for (auto& b : stats.histogram)
+            b.store(0, std::memory_order_relaxed);
+    }
+}
+
+// upper bound of the bucket the given fraction of calls falls into
+static uint64_t percentileNs(const std::array<uint64_t, NSTACK_STAT_BUCKETS>& buckets, uint64_t calls, double fraction) {
+    if (!calls)
+        return 0;
+
+    const uint64_t TARGET = std::max<uint64_t>(1, calls * fraction);
+    uint64_t       seen   = 0;
+    for (size_t i = 0; i < buckets.size(); ++i) {
+        seen += buckets[i];
+        if (seen >= TARGET)
+            return i == 0 ? 0 : (1ull << i) - 1;
+    }
+
+    return UINT64_MAX;
+}
+
+std::string CNstackStats::format(bool json) const {
+    std::string out = json ? "{" : "";
+    char        buf[512];
+
+    for (size_t op = 0; op < NSTACK_STAT_COUNT; ++op) {
+        const auto&                               STATS = m_aOps[op];
+        const uint64_t                            CALLS = STATS.calls.load(std::memory_order_relaxed);
+        const uint64_t                            TOTAL = STATS.totalNs.load(std::memory_order_relaxed);
+        const uint64_t                            MAX   = STATS.maxNs.load(std::memory_order_relaxed);
+        const uint64_t                            GEOM  = STATS.geometryChanges.load(std::memory_order_relaxed);
+        const uint64_t                            AVG   = CALLS ? TOTAL / CALLS : 0;
+        std::array<uint64_t, NSTACK_STAT_BUCKETS> buckets;
+        for (size_t i = 0; i < NSTACK_STAT_BUCKETS; ++i)
+            buckets[i] = STATS.histogram[i].load(std::memory_order_relaxed);
+
+        const auto P50 = percentileNs(buckets, CALLS, 0.5);
+        const auto P99 = percentileNs(buckets, CALLS, 0.99);
+
+        if (json) {
+            snprintf(buf, sizeof(buf), "%s\"%s\": {\"calls\": %lu, \"totalNs\": %lu, \"avgNs\": %lu, \"maxNs\": %lu, \"p50Ns\": %lu, \"p99Ns\": %lu, \"geometryChanges\": %lu, \"histogram\": [",
+                     op ? ", " : "", NSTACK_STAT_NAMES[op], CALLS, TOTAL, AVG, MAX, P50, P99, GEOM);
+            out += buf;
+            for (size_t i = 0; i < NSTACK_STAT_BUCKETS; ++i)
+                out += (i ? ", " : "") + std::to_string(buckets[i]);
+            out += "]}";
+        } else {
+            snprintf(buf, sizeof(buf), "%s: calls %lu, avg %.2fus, max %.2fus, p50 <%.2fus, p99 <%.2fus, geometry changes %lu\n", NSTACK_STAT_NAMES[op], CALLS, AVG / 1000.0,
+                     MAX / 1000.0, P50 / 1000.0, P99 / 1000.0, GEOM);
+            out += buf;
+        }
+    }
+
+    if (json)
+        out += "}";
+
+    return out;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+// Always-on layout counters, reported through `hyprctl nstack stats`.
+// Recording is a handful of relaxed atomic adds: no locks, no allocation, safe from any thread.
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum eNstackStatOp : uint8_t {
+    NSTACK_STAT_CALCULATE_WORKSPACE = 0,
+    NSTACK_STAT_APPLY_NODE,
+    NSTACK_STAT_RESIZE,
+    NSTACK_STAT_LAYOUTMSG,
+    NSTACK_STAT_RULE_LOOKUP,
+    NSTACK_STAT_COUNT,
+};
+
+inline constexpr const char* NSTACK_STAT_NAMES[NSTACK_STAT_COUNT] = {"calculateWorkspace", "applyNodeDataToWindow", "resizeActiveWindow", "layoutMessage", "workspaceRuleLookup"};
+
+// latency histogram, bucket i holds durations in [2^(i-1), 2^i) ns
+inline constexpr size_t NSTACK_STAT_BUCKETS = 40;
+
+struct SNstackOpStats {
+    std::atomic<uint64_t>                                  calls;
+    std::atomic<uint64_t>                                  totalNs;
+    std::atomic<uint64_t>                                  maxNs;
+    std::atomic<uint64_t>                                  geometryChanges; // windows whose target box changed
+    std::array<std::atomic<uint64_t>, NSTACK_STAT_BUCKETS> histogram;
+};
+
+class CNstackStats {
+  public:
+    void record(eNstackStatOp op, uint64_t ns) {
+        auto& stats = m_aOps[op];
+        stats.calls.fetch_add(1, std::memory_order_relaxed);
+        stats.totalNs.fetch_add(ns, std::memory_order_relaxed);
+        stats.histogram[std::min<size_t>(std::bit_width(ns), NSTACK_STAT_BUCKETS - 1)].fetch_add(1, std::memory_order_relaxed);
+
+        uint64_t max = stats.maxNs.load(std::memory_order_relaxed);
+        while (ns > max && !stats.maxNs.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+            ;
+        }
+    }
+
+    void addGeometryChanges(eNstackStatOp op, uint64_t count) {
+        m_aOps[op].geometryChanges.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void reset();
+
+    // one line per operation, or a JSON object keyed by operation name
+    std::string format(bool json) const;
+
+  private:
+    std::array<SNstackOpStats, NSTACK_STAT_COUNT> m_aOps;
+};
+
+inline CNstackStats g_nstackStats;
+
+// times the enclosing scope
+class CNstackStatTimer {
+  public:
+    explicit CNstackStatTimer(eNstackStatOp op) : m_eOp(op), m_tStart(std::chrono::steady_clock::now()) {}
+    ~CNstackStatTimer() {
+        g_nstackStats.record(m_eOp, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_tStart).count());
+    }
+
+    CNstackStatTimer(const CNstackStatTimer&)            = delete;
+    CNstackStatTimer& operator=(const CNstackStatTimer&) = delete;
+
+  private:
+    eNstackStatOp                         m_eOp;
+    std::chrono::steady_clock::time_point m_tStart;
+};
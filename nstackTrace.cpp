@@ -0,0 +1,67 @@
+#include "nstackTrace.hpp"
+#include <cstdio>
+#include <unistd.h>
+
+static uint32_t currentThreadID() {
+    static thread_local const uint32_t TID = gettid();
+    return TID;
+}
+
+void CNstackTrace::record(eNstackTraceEvent event, uint64_t startNs, uint64_t durNs, int64_t arg) {
+    const uint64_t INDEX = m_iHead.fetch_add(1, std::memory_order_relaxed);
+    auto&          slot  = m_aSlots[INDEX & (NSTACK_TRACE_CAPACITY - 1)];
+
+    // mark the slot as being written so a concurrent dump skips it
+    slot.sequence.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot.startNs  = startNs;
+    slot.durNs    = durNs;
+    slot.arg      = arg;
+    slot.threadID = currentThreadID();
+    slot.event    = event;
+
+    slot.sequence.store(INDEX + 1, std::memory_order_release);
+}
+
+int CNstackTrace::dumpChromeJson(const std::string& path) const {
+    const auto FILE = fopen(path.c_str(), "w");
+    if (!FILE)
+        return -1;
+
+    const uint64_t HEAD  = m_iHead.load(std::memory_order_acquire);
+    const uint64_t FIRST = HEAD > NSTACK_TRACE_CAPACITY ? HEAD - NSTACK_TRACE_CAPACITY : 0;
+    const pid_t    PID   = getpid();
+    int            count = 0;
+
+    fputs("{\"traceEvents\": [\n", FILE);
+
+    for (uint64_t i = FIRST; i < HEAD; ++i) {
+        const auto& SLOT = m_aSlots[i & (NSTACK_TRACE_CAPACITY - 1)];
+
+        if (SLOT.sequence.load(std::memory_order_acquire) != i + 1)
+            continue;
+
+        const uint64_t          START = SLOT.startNs;
+        const uint64_t          DUR   = SLOT.durNs;
+        const int64_t           ARG   = SLOT.arg;
+        const uint32_t          TID   = SLOT.threadID;
+        const eNstackTraceEvent EVENT = SLOT.event;
+
+        // overwritten while we were copying it
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (SLOT.sequence.load(std::memory_order_relaxed) != i + 1 || EVENT >= NSTACK_TRACE_COUNT)
+            continue;
+
+        fprintf(FILE, "%s{\"name\": \"%s\", \"cat\": \"nstack\", \"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %u, \"args\": {\"arg\": %ld}}", count ? ",\n" : "",
+                NSTACK_TRACE_NAMES[EVENT], START / 1000.0, DUR / 1000.0, PID, TID, ARG);
+        count++;
+    }
+
+    fputs("\n]}\n", FILE);
+
+    if (fclose(FILE) != 0)
+        return -1;
+
+    return count;
+}
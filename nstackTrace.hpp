@@ -0,0 +1,88 @@
+#pragma once
+
+// Layout span tracer, compiled in always and toggled at runtime (layoutmsg trace on|off).
+// Spans go into a fixed-size lock-free ring buffer, the oldest are overwritten.
+// While disabled a span costs one relaxed load and a branch.
+// layoutmsg tracedump <path> writes the buffer as Chrome trace-event JSON (Perfetto, chrome://tracing).
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+enum eNstackTraceEvent : uint8_t {
+    NSTACK_TRACE_RECALCULATE_MONITOR = 0,
+    NSTACK_TRACE_CALCULATE_WORKSPACE,
+    NSTACK_TRACE_APPLY_NODE,
+    NSTACK_TRACE_LAYOUTMSG,
+    NSTACK_TRACE_RESIZE,
+    NSTACK_TRACE_COUNT,
+};
+
+inline constexpr const char* NSTACK_TRACE_NAMES[NSTACK_TRACE_COUNT] = {"recalculateMonitor", "calculateWorkspace", "applyNodeDataToWindow", "layoutMessage", "resizeActiveWindow"};
+
+inline constexpr size_t      NSTACK_TRACE_CAPACITY = 1 << 15; // power of two
+
+struct SNstackTraceSlot {
+    std::atomic<uint64_t> sequence; // index + 1 of the span stored here, 0 while being written
+    uint64_t              startNs  = 0;
+    uint64_t              durNs    = 0;
+    int64_t               arg      = 0;
+    uint32_t              threadID = 0;
+    eNstackTraceEvent     event    = NSTACK_TRACE_RECALCULATE_MONITOR;
+};
+
+class CNstackTrace {
+  public:
+    bool enabled() const {
+        return m_bEnabled.load(std::memory_order_relaxed);
+    }
+
+    void setEnabled(bool enabled) {
+        m_bEnabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    void record(eNstackTraceEvent event, uint64_t startNs, uint64_t durNs, int64_t arg);
+
+    // returns the number of spans written, -1 if the file couldn't be written
+    int dumpChromeJson(const std::string& path) const;
+
+  private:
+    std::atomic<bool>     m_bEnabled = false;
+    std::atomic<uint64_t> m_iHead    = 0;
+    SNstackTraceSlot      m_aSlots[NSTACK_TRACE_CAPACITY];
+};
+
+inline CNstackTrace g_nstackTrace;
+
+inline uint64_t     nstackTraceNow() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// records the enclosing scope as one span
+class CNstackTraceSpan {
+  public:
+    CNstackTraceSpan(eNstackTraceEvent event, int64_t arg = 0) {
+        if (!g_nstackTrace.enabled()) [[likely]]
+            return;
+
+        m_bActive = true;
+        m_eEvent  = event;
+        m_iArg    = arg;
+        m_iStart  = nstackTraceNow();
+    }
+
+    ~CNstackTraceSpan() {
+        if (m_bActive) [[unlikely]]
+            g_nstackTrace.record(m_eEvent, m_iStart, nstackTraceNow() - m_iStart, m_iArg);
+    }
+
+    CNstackTraceSpan(const CNstackTraceSpan&)            = delete;
+    CNstackTraceSpan& operator=(const CNstackTraceSpan&) = delete;
+
+  private:
+    bool              m_bActive = false;
+    eNstackTraceEvent m_eEvent  = NSTACK_TRACE_RECALCULATE_MONITOR;
+    int64_t           m_iArg    = 0;
+    uint64_t          m_iStart  = 0;
+};